@@ -0,0 +1,216 @@
+/*******************************************************
+ *                                                     *
+ *  sann: Neural Network library                       *
+ *                                                     *
+ *  KERNELS BENCHMARK                                  *
+ *                                                     *
+ *  Giulio Auriemma                                    *
+ *                                                     *
+ *******************************************************/
+
+// Measures the throughput of the layer kernels and of the training on a grid of layer widths, mini-batch sizes
+// and activation functions. The results are written on the standard output, one row per measure.
+//
+// Usage: ./benchmark [csv|json|accuracy] [seconds]
+//          csv|json : The output format (csv by default).
+//          accuracy : Checks the approximated activations against the exact ones instead, the exit code is 1 if
+//                     an error is above its documented bound.
+//          seconds : The minimum time spent on each measure (0.1 by default).
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <functional>
+#include <cmath>
+#include "../src/sann/Network.hpp"
+#include "../src/sann/Layer.hpp"
+#include "../src/sann/math/Randomizer.hpp"
+#include "../src/sann/utility/Stopwatch.hpp"
+
+using namespace std;
+using namespace sann;
+using namespace sann::math;
+using namespace sann::utility;
+
+/// A single measure: the patterns/sec and the GFLOP/s of a kernel.
+struct measure{
+    string kernel, activation;
+    size_t width, batch;
+    double patternsPerSec, gflops;
+};
+
+volatile double sink = 0; // Keeps the compiler from dropping the computations.
+
+/**
+ * @brief Runs a function until at least minTime seconds have passed.
+ * 
+ * @param fnc - The function, each call works on batch patterns.
+ * @param minTime - The minimum time.
+ * @return double - The seconds per call.
+ */
+double timeIt(const function<void()> &fnc, const double minTime){
+    fnc(); // Warm up.
+
+    size_t calls = 0;
+    Stopwatch sw;
+    do{
+        fnc();
+        ++calls;
+    } while(sw.end() < minTime);
+
+    return sw.end() / calls;
+}
+
+Layer::weights_initializer initializer = [](const size_t m, const size_t n){
+    weightsMatrix weights(m);
+    for(size_t i = 0; i < m; ++i)
+        weights[i] = Randomizer::randomRangeVector<double>(-0.5, 0.5, n);
+    return weights;
+};
+
+/**
+ * @brief Measures all the kernels for a layer width, a mini-batch size and an activation function.
+ * 
+ * @param width - The number of inputs and of neurons of the layers.
+ * @param batch - The number of patterns processed before an update of the weights.
+ * @param name - The name of the activation.
+ * @param func - The activation.
+ * @param minTime - The minimum time of each measure.
+ * @param results - The vector where the measures are added.
+ */
+void benchLayer(const size_t width, const size_t batch, const string &name, const Func &func, const double minTime,
+                    vector<measure> &results){
+    const double w = width, ffFlops = 2 * w * w + w, bpFlops = 4 * w * w + w, upFlops = 7 * w * (w + 1);
+    vector<vector<double>> inputs(batch), errors(batch);
+    for(size_t i = 0; i < batch; ++i){
+        inputs[i] = Randomizer::randomRangeVector<double>(-1, 1, width);
+        errors[i] = Randomizer::randomRangeVector<double>(-0.1, 0.1, width);
+    }
+
+    Layer layer{width, func};
+    layer.setWeights(initializer, width);
+    parameters pars{1, batch, 0.01f, 0.5f, 0.0001f, [](parameters&, size_t){}};
+    auto add = [&](const string &kernel, const double seconds, const double flops){
+        results.push_back({kernel, name, width, batch, batch / seconds, batch * flops / seconds * 1e-9});
+    };
+
+    add("feed_forward", timeIt([&](){
+        for(size_t i = 0; i < batch; ++i)  sink = sink + layer.feed_forward(inputs[i])[0];
+    }, minTime), ffFlops);
+
+    add("back_propagation", timeIt([&](){
+        for(size_t i = 0; i < batch; ++i)  sink = sink + layer.back_propagation(inputs[i], errors[i])[0];
+    }, minTime), bpFlops);
+
+    // The transposed copy is refreshed once per mini-batch, as after each update of the weights.
+    layer.setTransposedWeights(true);
+    add("back_propagation_transposed", timeIt([&](){
+        layer.setTransposedWeights(true);
+        for(size_t i = 0; i < batch; ++i)  sink = sink + layer.back_propagation(inputs[i], errors[i])[0];
+    }, minTime), bpFlops);
+    layer.setTransposedWeights(false);
+
+    add("updateWeights", timeIt([&](){ layer.updateWeights(pars); }, minTime), upFlops / batch);
+
+    // A net with two hidden layers of the given width and one output. The first layer does not propagate errors.
+    const double netFlops = 2 * ffFlops + 2 * w + 1, stepFlops = netFlops + 2 * bpFlops - 2 * w * w + 4 * w + 1;
+    Network net{{width, width, width, 1}, func, initializer};
+    add("compute", timeIt([&](){
+        for(size_t i = 0; i < batch; ++i)  sink = sink + net.compute(inputs[i])[0];
+    }, minTime), netFlops);
+
+    dataSet set;
+    const size_t patterns = 1024;
+    for(size_t i = 0; i < patterns; ++i){
+        set.inputs.push_back(Randomizer::randomRangeVector<double>(-1, 1, width));
+        set.results.push_back({Randomizer::randomRange<double>(-1, 1)});
+    }
+    parameters epochPars{1, batch, 0.01f, 0.5f, 0.0001f, [](parameters&, size_t){}};
+    double epochTime = timeIt([&](){ net.train(set, Network::nullEstimator, epochPars); }, minTime);
+    double updates = patterns / batch, netUpFlops = 2 * upFlops + 7 * (w + 1);
+    results.push_back({"epoch", name, width, batch, patterns / epochTime, 
+                        (patterns * stepFlops + updates * netUpFlops) / epochTime * 1e-9});
+}
+
+/**
+ * @brief Compares the approximated activations with the exact ones on a dense grid of [-30, 30] and prints their
+ *        maximum absolute error (of the function and of its derivative) and the time per call of both.
+ * 
+ * @param minTime - The minimum time spent on each measure.
+ * @return int - 0 if all the errors are within the documented bounds, 1 otherwise.
+ */
+int checkAccuracy(const double minTime){
+    struct approximation{
+        string name;
+        Func exact, fast;
+        double bound;
+    };
+    const vector<approximation> approximations = {{"sigmoid", Func::sigmoid, Func::fastSigmoid, Func::FAST_SIGMOID_ERROR},
+                                                   {"tanh", Func::tanH, Func::fastTanH, Func::FAST_TANH_ERROR}};
+    const size_t points = 600001;
+    vector<double> xs(points);
+    for(size_t i = 0; i < points; ++i)    xs[i] = -30 + 60.0 * i / (points - 1);
+
+    int ret = 0;
+    cout << "function,max_abs_error,max_abs_derivative_error,bound,exact_ns,approximated_ns\n";
+    for(const approximation &a : approximations){
+        double maxErr = 0, maxDerivErr = 0;
+        for(double x : xs){
+            maxErr = max(maxErr, abs(a.fast.call(x) - a.exact.call(x)));
+            maxDerivErr = max(maxDerivErr, abs(a.fast.derivative(x) - a.exact.derivative(x)));
+        }
+
+        auto timeFunc = [&](const Func &f){
+            return timeIt([&](){
+                double acc = 0;
+                for(double x : xs)  acc += f.call(x);
+                sink = sink + acc;
+            }, minTime) / points * 1e9;
+        };
+        double exactNs = timeFunc(a.exact), fastNs = timeFunc(a.fast);
+
+        cout << a.name << ',' << maxErr << ',' << maxDerivErr << ',' << a.bound << ',' << exactNs << ',' << fastNs << '\n';
+        // The derivatives are y(1 - y) and 1 - y^2, so their error is at most twice the one of the function.
+        if(maxErr > a.bound || maxDerivErr > 2 * a.bound)   ret = 1;
+    }
+    cout << flush;
+
+    return ret;
+}
+
+int main(int argc, char **argv){
+    const double minTime = argc > 2 ? stod(argv[2]) : 0.1;
+    if(argc > 1 && string(argv[1]) == "accuracy")   return checkAccuracy(minTime);
+
+    const bool json = argc > 1 && string(argv[1]) == "json";
+    const vector<size_t> widths = {16, 64, 256}, batches = {1, 32};
+    const vector<pair<string, Func>> activations = {{"sigmoid", Func::sigmoid}, {"tanh", Func::tanH}, 
+                                                        {"relu", Func::ReLU}};
+    vector<measure> results;
+
+    Randomizer::setSeed(42);
+    for(size_t width : widths)
+        for(size_t batch : batches)
+            for(const auto &act : activations)
+                benchLayer(width, batch, act.first, act.second, minTime, results);
+
+    if(json){
+        cout << "[\n";
+        for(size_t i = 0; i < results.size(); ++i){
+            const measure &m = results[i];
+            cout << "  {\"kernel\": \"" << m.kernel << "\", \"activation\": \"" << m.activation << "\", \"width\": " 
+                << m.width << ", \"batch\": " << m.batch << ", \"patterns_per_sec\": " << m.patternsPerSec 
+                << ", \"gflops\": " << m.gflops << "}" << (i + 1 < results.size() ? ",\n" : "\n");
+        }
+        cout << "]" << endl;
+    }
+    else{
+        cout << "kernel,activation,width,batch,patterns_per_sec,gflops\n";
+        for(const measure &m : results)
+            cout << m.kernel << ',' << m.activation << ',' << m.width << ',' << m.batch << ',' << m.patternsPerSec 
+                << ',' << m.gflops << '\n';
+        cout << flush;
+    }
+
+    return 0;
+}
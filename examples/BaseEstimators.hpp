@@ -4,7 +4,6 @@
 #include <vector>
 #include <string>
 #include <iostream>
-#include "../src/sann/constants.h"
 #include "../src/sann/Estimator.hpp"
 #include "../src/sann/Validator.hpp"
 #include "../src/sann/math/Plotter.hpp"
@@ -57,6 +56,17 @@ public:
 
     void terminate(){ }
 
+    // Print the time spent in each phase every 100 epochs (only with the PROFILE_MODE option).
+    void profile(const std::size_t epoch, const sann::utility::Profiler::timings &timings){
+        if(epoch % 100 != 0)    return;
+
+        std::string line = "   ";
+        for(std::size_t i = 0; i < sann::utility::Profiler::PHASES; ++i)
+            line += " " + sann::utility::Profiler::name((sann::utility::Profiler::phase)i) + ": " + 
+                    std::to_string(timings[i] * 1e3) + "ms";
+        std::cout << line << std::endl;
+    }
+
     double getAccuracy(){ return this->accuracy; }
 
     double getError(){ return this->error; }
@@ -102,7 +112,7 @@ class BaseVdEstimator : public sann::Validator::VdValidEstimator{
 private:
     std::size_t size = 0;
     std::string filename;
-    std::string result = "";
+    std::vector<sann::Validator::record> history;
 public:
     BaseVdEstimator(sann::Validator::TrValidEstimator &est) : VdValidEstimator(est){
         this->filename = dynamic_cast<BaseTrEstimator&>(est).getName();
@@ -133,11 +143,16 @@ public:
 
     void finalize(){
         this->error /= this->size; this->accuracy /= this->size;
-        this->result += std::to_string(this->getEpoch()) + ',' + std::to_string(error) + ',' + std::to_string(accuracy) + '\n';
+        this->history.push_back({this->getEpoch(), error, accuracy});
     }
 
     void terminate(){
-        sann::utility::FileManager::writeFile(sann::FILES_DIR + "validation/" + this->filename + ".vd.csv", this->result);
+        this->writeHistory(this->filename);
+    }
+
+    void writeHistory(const std::string &filename) const{
+        sann::Validator::writeRecords(sann::utility::FileManager::getFilesDir() + "validation/" + filename + ".vd.csv", 
+                                        this->history, this->history.size());
     }
 };
 
@@ -9,7 +9,7 @@
 #include "../src/sann/Regularizer.hpp"
 #include "../src/sann/utility/Logger.hpp"
 #include "../src/sann/utility/Stopwatch.hpp"
-#include "../src/sann/constants.h"
+#include "constants.h"
 
 using namespace std;
 using namespace sann;
@@ -17,6 +17,9 @@ using namespace sann::math;
 using namespace sann::utility;
 
 int main(int argc, char **argv){ 
+    // The library writes its results in the files folder of the sources, as the data sets are read from there.
+    FileManager::setFilesDir(FILES_DIR);
+
     if(argc <= 1){
         cerr << "Insert the number of time the risk estimation has to be executed on different split." << endl;
         return -1;
@@ -47,6 +50,13 @@ int main(int argc, char **argv){
         int pivot2 = Randomizer::randomRange<int>(0, trainSet.inputs.size() - testLength - 1);
         dataSet validSet = trainSet.extractData(pivot2, pivot2 + testLength);
 
+        // Standardize the inputs with the statistics of the training set only.
+        Regularizer::Pipeline pipeline{{Regularizer::Pipeline::Z_SCORE}};
+        pipeline.fit(trainSet);
+        trainSet = pipeline.apply(trainSet);
+        validSet = pipeline.apply(validSet);
+        testSet = pipeline.apply(testSet);
+
         // Create estimator
         BaseEstimator estTr{"trainErrors"}, estTe{"testErrors"};
 
@@ -54,6 +64,8 @@ int main(int argc, char **argv){
         auto container = val.selectModelWithRisk(trainSet, validSet, testSet, estTr, estTe);
 
         cout << "Risk: " << container.risk << endl;
+        if(val.getBudgetReport().expired)
+            cout << "Deadline reached, unfinished combinations: " << val.getBudgetReport().unfinished.size() << endl;
 
         // Plot the point
         Plotter plt("points");
@@ -9,7 +9,7 @@
 #include "../src/sann/Regularizer.hpp"
 #include "../src/sann/utility/Logger.hpp"
 #include "../src/sann/utility/Stopwatch.hpp"
-#include "../src/sann/constants.h"
+#include "constants.h"
 
 using namespace std;
 using namespace sann;
@@ -19,13 +19,17 @@ using namespace sann::utility;
 void randomShuffle(dataSet &ds);
 
 int main(int argc, char **argv){ 
+    // The library writes its results in the files folder of the sources, as the data sets are read from there.
+    FileManager::setFilesDir(FILES_DIR);
+
     ///////////////////////////////////////MONK DATASET////////////////////////////////////////
 
     dataSet trainSet = FileManager::readDataSet(FILES_DIR + "dataSet/" + DATA_SET + ".train", 8, ' ', {0}, 7);
     dataSet testSet = FileManager::readDataSet(FILES_DIR + "dataSet/" + DATA_SET + ".test", 8, ' ', {0}, 7);
   
-    dataSet trainKSet = Regularizer::getOneOfKDataSet(trainSet);
-    dataSet testKSet = Regularizer::getOneOfKDataSet(testSet);
+    // The one-of-k inputs are stored as the indexes of their active elements.
+    dataSet trainKSet = Regularizer::getSparseOneOfKDataSet(trainSet);
+    dataSet testKSet = Regularizer::getSparseOneOfKDataSet(testSet);
     
     // Create estimator
     BaseEstimator estTr{"trainErrors"}, estTe{"testErrors"};
@@ -46,6 +50,8 @@ int main(int argc, char **argv){
     auto container = val.selectModelWithRisk(trainKSet, testKSet, estTr, estTe, 5);
 
     cout << "Risk: " << container.risk << endl;
+    if(val.getBudgetReport().expired)
+        cout << "Deadline reached, unfinished combinations: " << val.getBudgetReport().unfinished.size() << endl;
     cout << "In training:" << estTr.getError() << " - " << estTr.getAccuracy() << endl;
     cout << "In test:" << estTe.getError() << " - " << estTe.getAccuracy() << endl;
 
@@ -61,14 +67,12 @@ int main(int argc, char **argv){
 }
 
 void randomShuffle(dataSet &ds){
-    size_t size = ds.inputs.size();
-    unsigned int numOfShuffles = math::Randomizer::randomRange<unsigned int>(size * 2, size * 5);
-    vector<size_t> swapVector = {};
-
-    for(size_t i = 0; i < numOfShuffles; i++){
-        int n1 = math::Randomizer::randomRange<int>(0, size),
-            n2 = math::Randomizer::randomRange<int>(0, size);
-        swap(ds.inputs[n1], ds.inputs[n2]);
-        swap(ds.results[n1], ds.results[n2]);
+    // Fisher-Yates: swapping two rows only swaps their buffers.
+    if(ds.inputs.size() < 2)    return;
+    for(size_t i = ds.inputs.size() - 1; i > 0; i--){
+        size_t j = math::Randomizer::randomRange<size_t>(0, i + 1);
+        swap(ds.inputs[i], ds.inputs[j]);
+        swap(ds.results[i], ds.results[j]);
+        if(ds.isSparse())   swap(ds.active[i], ds.active[j]);
     }
 }
\ No newline at end of file
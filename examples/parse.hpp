@@ -11,6 +11,7 @@ using namespace sann::math;
 
 Validator parse_validator(const string &file, const bool isClass = true);
 Network parse_net(const string &fileName, parameters &hyperP);
+vector<Func> parse_functions(const json &functions, const bool approximate);
 vector<weightsMatrix> randomWeights(const vector<size_t> &sizes);
 vector<weightsMatrix> randomGaussianWeights(const vector<size_t> &sizes);
 vector<weightsMatrix> randomGaussianWeightsWithSqrt(const vector<size_t> &sizes);
@@ -51,16 +52,7 @@ Validator parse_validator(const string &file, const bool isClass){
     auto nets = vConf["nets"];
 
     for(size_t i = 0; i < nets.size(); ++i){
-        vector<Func> funcVec = {};
-        auto functions = nets[i]["functions"];
-
-        for(size_t i = 0; i < functions.size(); ++i){
-            string tmp = functions[i];
-            if(tmp == "linear")         funcVec.push_back(Func::linear);
-            else if(tmp == "sigmoid")   funcVec.push_back(Func::sigmoid);
-            else if(tmp == "tanh")      funcVec.push_back(Func::tanH);
-            else if(tmp == "relu")      funcVec.push_back(Func::ReLU);
-        }
+        vector<Func> funcVec = parse_functions(nets[i]["functions"], nets[i].value("approximate", false));
 
         Network net{nets[i]["layers"], funcVec, [](const size_t m, const size_t n){
             weightsMatrix weights(m);
@@ -103,6 +95,17 @@ Validator parse_validator(const string &file, const bool isClass){
     for(auto eta : etas)
         val.addModelSelectionParameters(Validator::ETAS, eta); 
 
+    // The number of combinations trained together.
+    val.setBatchedSearch(vConf.value("batch", 1));
+
+    // Choose how the selected model is trained.
+    string finalTraining = vConf.value("final_training", "retrain");
+    if(finalTraining == "candidate")        val.setFinalTraining(Validator::CANDIDATE);
+    else if(finalTraining == "warm_start")  val.setFinalTraining(Validator::WARM_START);
+
+    // The seconds and the megabytes given to the search.
+    val.setBudget(vConf.value("time_budget", 0.), vConf.value("memory_budget", (size_t)0) * 1024 * 1024);
+
     return val;
 }
 
@@ -111,16 +114,7 @@ Network parse_net(const string &fileName, parameters &hyperP){
     json conf;
     validConf >> conf;
 
-    vector<Func> funcVec = {};
-    auto functions = conf["functions"];
-
-    for(size_t i = 0; i < functions.size(); ++i){
-        string tmp = functions[i];
-        if(tmp == "linear")         funcVec.push_back(Func::linear);
-        else if(tmp == "sigmoid")   funcVec.push_back(Func::sigmoid);
-        else if(tmp == "tanh")      funcVec.push_back(Func::tanH);
-        else if(tmp == "relu")      funcVec.push_back(Func::ReLU);
-    }
+    vector<Func> funcVec = parse_functions(conf["functions"], conf.value("approximate", false));
 
     Network net{conf["layers"], funcVec, [](const size_t m, const size_t n){
         weightsMatrix weights(m);
@@ -139,6 +133,21 @@ Network parse_net(const string &fileName, parameters &hyperP){
     return net;
 }
 
+// The activation functions of a net. If approximate is true, sigmoid and tanh use the fast approximations.
+vector<Func> parse_functions(const json &functions, const bool approximate){
+    vector<Func> funcVec = {};
+
+    for(size_t i = 0; i < functions.size(); ++i){
+        string tmp = functions[i];
+        if(tmp == "linear")         funcVec.push_back(Func::linear);
+        else if(tmp == "sigmoid")   funcVec.push_back(approximate ? Func::fastSigmoid : Func::sigmoid);
+        else if(tmp == "tanh")      funcVec.push_back(approximate ? Func::fastTanH : Func::tanH);
+        else if(tmp == "relu")      funcVec.push_back(Func::ReLU);
+    }
+
+    return funcVec;
+}
+
 /**********************************WEIGHTS INITS FUNCTION**********************************/
 
 vector<weightsMatrix> randomWeights(const vector<size_t> &sizes){
@@ -146,7 +155,7 @@ vector<weightsMatrix> randomWeights(const vector<size_t> &sizes){
 
     for(size_t i = 0; i < weights.size(); ++i)
         for(size_t j = 0; j < sizes[i+1]; ++j)
-            weights[i].push_back(math::Randomizer::randomRangeVector<double>(-0.5, 0.5, sizes[i]));
+            weights[i].push_back(math::Randomizer::randomRangeVector<double>(-0.5, 0.5, sizes[i] + 1));
             
 
     return weights;    
@@ -157,7 +166,7 @@ vector<weightsMatrix> randomGaussianWeights(const vector<size_t> &sizes){
 
     for(size_t i = 0; i < weights.size(); ++i)
         for(size_t j = 0; j < sizes[i+1]; ++j)
-            weights[i].push_back(math::Randomizer::randomGaussianVector<double>(0, 1./sizes[i], sizes[i]));
+            weights[i].push_back(math::Randomizer::randomGaussianVector<double>(0, 1./sizes[i], sizes[i] + 1));
 
     return weights;  
 }
@@ -168,7 +177,7 @@ vector<weightsMatrix> randomGaussianWeightsWithSqrt(const vector<size_t> &sizes)
 
     for(size_t i = 0; i < weights.size(); ++i)
         for(size_t j = 0; j < sizes[i+1]; ++j)
-            weights[i].push_back(math::Randomizer::randomGaussianVector<double>(0, 1./sqrt(sizes[i]), sizes[i]));
+            weights[i].push_back(math::Randomizer::randomGaussianVector<double>(0, 1./sqrt(sizes[i]), sizes[i] + 1));
 
     return weights;      
 }
@@ -0,0 +1,177 @@
+/*******************************************************
+ *                                                     *
+ *  sann: Neural Network library                       *
+ *                                                     *
+ *  EMBEDDING CLASS FILE                               *
+ *                                                     *
+ *  Giulio Auriemma                                    *
+ *                                                     *
+ *******************************************************/
+
+#include "Embedding.hpp"
+
+// Other system includes.
+#include <stdexcept>
+#include <algorithm>
+
+using namespace std;
+
+namespace sann{
+
+    /**
+     * @brief Creates an empty embedding, that a net does not use.
+     * 
+     */
+    Embedding::Embedding() : dim(0){ }
+
+    /**
+     * @brief Creates the embedding of a set of categorical attributes.
+     * 
+     * @param categories - The number of categories of each attribute.
+     * @param dim - The size of the vector of each category.
+     * @param init - The function that generates the random table, given the number of categories and dim.
+     */
+    Embedding::Embedding(const vector<size_t> &categories, const size_t dim, const Layer::weights_initializer &init) :
+        dim(dim){
+        if(dim == 0 || categories.empty())
+            throw invalid_argument("An embedding needs at least one attribute and one dimension.");
+
+        for(size_t i = 0; i < categories.size(); ++i)
+            this->fields.insert(this->fields.end(), categories[i], i);
+
+        this->setTable(init(this->fields.size(), dim));
+    }
+
+    /**
+     * @brief Sets the table of the embedding.
+     * 
+     * @param table - The new table, with a row of size dim for each category.
+     */
+    void Embedding::setTable(const weightsMatrix &table){
+        if(table.size() != this->fields.size() || 
+            any_of(table.begin(), table.end(), [this](const vector<double> &row){ return row.size() != this->dim; }))
+            throw invalid_argument("The size of the table does not match the expected one.");
+
+        this->table = table;
+        this->currErrors = weightsMatrix{table.size(), vector<double>(dim)};
+        this->prevErrors = weightsMatrix{table.size(), vector<double>(dim)};
+        this->touched.clear();
+        this->used.assign(table.size(), false);
+    }
+
+    /**
+     * @brief Copies a table with the same shape of the current one inside the buffers already allocated.
+     * 
+     * @param table - The table to copy.
+     */
+    void Embedding::copyTable(const weightsMatrix &table){
+        if(table.size() != this->table.size())
+            throw invalid_argument("The shapes of the two tables do not match.");
+
+        for(size_t i = 0; i < table.size(); ++i)
+            copy(table[i].begin(), table[i].end(), this->table[i].begin());
+    }
+
+    /**
+     * @brief Returns the table of the embedding.
+     * 
+     * @return weightsMatrix - The table.
+     */
+    const weightsMatrix& Embedding::getTable() const{
+        return this->table;
+    }
+
+    /**
+     * @brief Returns the number of categories of all the attributes, i.e. the size of the sparse inputs.
+     * 
+     * @return size_t - The number of categories.
+     */
+    size_t Embedding::getCategories() const{
+        return this->fields.size();
+    }
+
+    /**
+     * @brief Returns the size of the output, i.e. the size of the first layer inputs.
+     * 
+     * @return size_t - The size of the output.
+     */
+    size_t Embedding::getSize() const{
+        return this->fields.empty() ? 0 : (this->fields.back() + 1) * this->dim;
+    }
+
+    /**
+     * @brief Returns the number of weights of the table, i.e. a row of dim weights for each category.
+     * 
+     * @return size_t - The number of weights.
+     */
+    size_t Embedding::getWeightsNumber() const{
+        return this->fields.size() * this->dim;
+    }
+
+    /**
+     * @brief Returns true if the embedding has no table.
+     * 
+     * @return bool - True if the embedding is empty.
+     */
+    bool Embedding::empty() const{
+        return this->fields.empty();
+    }
+
+    /**
+     * @brief Computes the output for the given categories. The vector of each attribute is the row of its active
+     *        category, an attribute with no active category has a vector of zeros.
+     * 
+     * @param active - The indexes of the active categories.
+     * @return std::vector<double> - The output.
+     */
+    vector<double> Embedding::feed_forward(const vector<size_t> &active) const{
+        vector<double> outputs(this->getSize());
+
+        for(size_t k = 0; k < active.size(); ++k){
+            const vector<double> &row = this->table[active[k]];
+            copy(row.begin(), row.end(), outputs.begin() + this->fields[active[k]] * this->dim);
+        }
+
+        return outputs;
+    }
+
+    /**
+     * @brief Accumulates the errors on the rows of the active categories only.
+     * 
+     * @param active - The indexes of the active categories.
+     * @param errors - The errors of the first layer, with respect to the output of the embedding.
+     */
+    void Embedding::back_propagation(const vector<size_t> &active, const vector<double> &errors){
+        for(size_t k = 0; k < active.size(); ++k){
+            size_t r = active[k], offset = this->fields[r] * this->dim;
+
+            for(size_t d = 0; d < this->dim; ++d)
+                this->currErrors[r][d] += errors[offset + d];
+
+            if(!this->used[r]){
+                this->used[r] = true;
+                this->touched.push_back(r);
+            }
+        }
+    }
+
+    /**
+     * @brief Updates the rows used since the last update, the other ones are not touched at all. So the
+     *        momentum and the L2 term of a row are applied only when the row is used.
+     * 
+     * @param hyperP - The hyperparameters.
+     */
+    void Embedding::updateWeights(const sann::parameters &hyperP){
+        for(size_t r : this->touched){
+            for(size_t d = 0; d < this->dim; ++d){
+                double dwi = hyperP.eta * (this->currErrors[r][d] / hyperP.mb) + hyperP.mi * this->prevErrors[r][d];
+
+                this->table[r][d] += dwi - hyperP.lambda * this->table[r][d];
+                this->prevErrors[r][d] = dwi;
+                this->currErrors[r][d] = 0; // Reset the error.
+            }
+            this->used[r] = false;
+        }
+        this->touched.clear();
+    }
+}
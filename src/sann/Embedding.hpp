@@ -0,0 +1,61 @@
+/*******************************************************
+ *                                                     *
+ *  sann: Neural Network library                       *
+ *                                                     *
+ *  EMBEDDING CLASS HEADER                             *
+ *                                                     *
+ *  Giulio Auriemma                                    *
+ *                                                     *
+ *******************************************************/
+
+#ifndef S_EMBEDDING_S
+#define S_EMBEDDING_S
+
+// System libraries include.
+#include <vector>
+
+// My includes.
+#include "dataStructures.h"
+#include "Layer.hpp"
+
+namespace sann{
+
+/// This class maps categorical attributes to dense learned vectors. The categories of all the attributes are
+/// numbered one after the other (the same indexes of Regularizer::getSparseOneOfKDataSet), and each one has its
+/// own row in the table. The output is the concatenation of the rows of the active categories, one per attribute.
+class Embedding{
+private:
+    // ATTRIBUTES
+
+    std::size_t dim;
+    weightsMatrix table, currErrors, prevErrors;
+    std::vector<std::size_t> fields;    // The attribute of each category.
+    std::vector<std::size_t> touched;   // The rows used since the last update.
+    std::vector<bool> used;
+
+public:
+    // CONSTRUCTORS
+
+    Embedding();
+    Embedding(const std::vector<std::size_t> &categories, const std::size_t dim, const Layer::weights_initializer &init);
+
+    // METHODS
+
+    void setTable(const weightsMatrix &table);
+    void copyTable(const weightsMatrix &table);
+    const weightsMatrix& getTable() const;
+    std::size_t getCategories() const;
+    std::size_t getSize() const;
+    std::size_t getWeightsNumber() const;
+    bool empty() const;
+
+    // COMPUTATION
+
+    std::vector<double> feed_forward(const std::vector<std::size_t> &active) const;
+    void back_propagation(const std::vector<std::size_t> &active, const std::vector<double> &errors);
+    void updateWeights(const sann::parameters &hyperP);
+};
+
+}
+
+#endif
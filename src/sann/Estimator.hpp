@@ -15,6 +15,7 @@
 #include <vector>
 
 // My includes.
+#include "utility/Profiler.hpp"
 
 namespace sann{
 
@@ -25,13 +26,24 @@ namespace sann{
 /// - update: it is called at the end of training iteration of a single pattern.
 /// - plot: it is called at the end of the epoch, after updating the weight.
 /// - terminate: it is called once just before returning training method. 
+/// - toEvaluate: it is called on the estimator of the test set before init, it returns false if the estimator
+///               is not interested in the given epoch. In that case the test set is not evaluated and init, 
+///               update and plot are not called for that epoch. By default every epoch is evaluated.
+/// - isBest: it is called on the estimator of the test set after plot, it returns true if the outputs of the
+///           epoch are the best seen so far. It is used to keep the best weights (false by default).
+/// - profile: it is called on the estimator of the training set after plot, with the seconds spent in each phase of
+///            the epoch (see utility::Profiler). It is called only if the library is compiled with S_PROFILE_MODE_S.
 class Estimator{
 public:
+    virtual ~Estimator(){ }
     virtual void init(const std::size_t epoch) = 0;
     virtual bool stoppingCriteria() = 0;
     virtual void update(const std::vector<double> &out, const std::vector<double> &expected) = 0;
     virtual void plot() = 0;
     virtual void terminate() = 0;
+    virtual bool toEvaluate(const std::size_t epoch){ return true; }
+    virtual bool isBest(){ return false; }
+    virtual void profile(const std::size_t epoch, const utility::Profiler::timings &timings){ }
 };
 
 }
@@ -0,0 +1,520 @@
+/*******************************************************
+ *                                                     *
+ *  sann: Neural Network library                       *
+ *                                                     *
+ *  FULL BATCH TRAINER CLASS FILE                      *
+ *                                                     *
+ *  Giulio Auriemma                                    *
+ *                                                     *
+ *******************************************************/
+#include "FullBatchTrainer.hpp"
+
+// Other system includes.
+#include <stdexcept>
+#include <cmath>
+#include <algorithm>
+
+using namespace std;
+
+namespace sann{
+    const double SUFFICIENT_DECREASE = 1e-4;        // The constant of the first Wolfe condition.
+    const size_t MAX_EVALUATIONS = 20;              // The evaluations of the objective in a line search.
+
+    namespace{
+        /**
+         * @brief The estimator of the evaluations of the objective: it sums the loss of the patterns and keeps their
+         *        outputs, so the estimators of the training only see the ones of the accepted weights.
+         *
+         */
+        class Recorder : public Estimator{
+        public:
+            const FullBatchTrainer::loss_func &loss;
+            double total = 0;
+            vector<vector<double>> outputs;
+
+            Recorder(const FullBatchTrainer::loss_func &loss) : loss(loss){ }
+            void init(const size_t epoch){ }
+            bool stoppingCriteria(){ return false; }
+            void update(const vector<double> &out, const vector<double> &expected){
+                this->total += this->loss(expected, out);
+                this->outputs.push_back(out);
+            }
+            void plot(){ }
+            void terminate(){ }
+        };
+
+        double dot(const vector<double> &x, const vector<double> &y){
+            double sum = 0;
+            for(size_t i = 0; i < x.size(); ++i)
+                sum += x[i] * y[i];
+            return sum;
+        }
+
+        double halfSquaredError(const vector<double> &target, const vector<double> &out){
+            double sum = 0;
+            for(size_t i = 0; i < target.size(); ++i)
+                sum += (target[i] - out[i]) * (target[i] - out[i]);
+            return sum / 2;
+        }
+
+        /**
+         * @brief Factorizes a symmetric positive definite matrix as L * L^T, in place. Only the lower triangle of
+         *        the matrix is read and L is written there.
+         *
+         * @param a - The matrix n x n, row by row.
+         * @param n - The order of the matrix.
+         * @return bool - False if the matrix is not positive definite.
+         */
+        bool cholesky(vector<double> &a, const size_t n){
+            for(size_t j = 0; j < n; ++j){
+                double *rj = a.data() + j * n, d = rj[j];
+                for(size_t k = 0; k < j; ++k)
+                    d -= rj[k] * rj[k];
+                if(!(d > 0))    return false;
+                rj[j] = sqrt(d);
+
+                for(size_t i = j + 1; i < n; ++i){
+                    double *ri = a.data() + i * n, sum = ri[j];
+                    for(size_t k = 0; k < j; ++k)
+                        sum -= ri[k] * rj[k];
+                    ri[j] = sum / rj[j];
+                }
+            }
+            return true;
+        }
+
+        /**
+         * @brief Solves L * L^T * x = b, with L computed by cholesky.
+         *
+         * @param l - The factor.
+         * @param n - The order of the matrix.
+         * @param x - The known terms, overwritten by the solution.
+         */
+        void choleskySolve(const vector<double> &l, const size_t n, vector<double> &x){
+            for(size_t i = 0; i < n; ++i){
+                const double *ri = l.data() + i * n;
+                for(size_t k = 0; k < i; ++k)
+                    x[i] -= ri[k] * x[k];
+                x[i] /= ri[i];
+            }
+            for(size_t i = n; i-- > 0;){
+                for(size_t k = i + 1; k < n; ++k)
+                    x[i] -= l[k * n + i] * x[k];
+                x[i] /= l[i * n + i];
+            }
+        }
+    }
+
+    // CONSTRUCTORS
+
+    /**
+     * @brief Creates a new trainer. The default loss is half the squared error, the one of the default error
+     *        function of the networks.
+     *
+     * @param type - The optimization method.
+     */
+    FullBatchTrainer::FullBatchTrainer(const method type) : type(type), loss(halfSquaredError){ }
+
+    // METHODS
+
+    /**
+     * @brief Sets the number of corrections kept by L-BFGS to approximate the inverse hessian (10 by default).
+     *
+     * @param m - The number of corrections.
+     */
+    void FullBatchTrainer::setMemory(const size_t m){
+        if(m == 0)
+            throw invalid_argument("L-BFGS needs at least a correction.");
+        this->memory = m;
+    }
+
+    /**
+     * @brief Sets the tolerance on the gradient: the training stops when the absolute value of all its components
+     *        is below it (1e-6 by default).
+     *
+     * @param tolerance - The tolerance.
+     */
+    void FullBatchTrainer::setTolerance(const double tolerance){
+        this->tolerance = tolerance;
+    }
+
+    /**
+     * @brief Sets the loss of a pattern. Its opposite derivative wrt the outputs must be the error function of the
+     *        trained networks. Levenberg-Marquardt always minimizes half the squared error.
+     *
+     * @param loss - The loss.
+     */
+    void FullBatchTrainer::setLoss(const loss_func &loss){
+        this->loss = loss;
+    }
+
+    /**
+     * @brief Searches a step along a descent direction that satisfies the strong Wolfe conditions, by expanding the
+     *        step until a minimum is bracketed and then shrinking the bracket with cubic interpolation (Nocedal and
+     *        Wright, algorithms 3.5 and 3.6). L-BFGS asks for a loose curvature condition, the conjugate gradient for
+     *        a tight one.
+     *
+     * @param evaluate - The function that evaluates the objective at the weights of a point.
+     * @param start - The starting point.
+     * @param direction - The descent direction.
+     * @param step - The first step tried, it is set to the step found.
+     * @param next - The point found.
+     * @return bool - True if a step has been found, false if none lowered the objective.
+     */
+    bool FullBatchTrainer::lineSearch(const function<void(point &p)> &evaluate, const point &start,
+                                        const vector<double> &direction, double &step, point &next) const{
+        const double slope0 = dot(start.gradient, direction), curvature = this->type == LBFGS ? 0.9 : 0.1;
+        // The ends of the bracket: lo is the best step found, hi the other end.
+        double lo = 0, loValue = start.value, loSlope = slope0, hi = 0, hiValue = 0, hiSlope = 0;
+        bool bracketed = false;
+        point best;
+
+        for(size_t i = 0; i < MAX_EVALUATIONS; ++i){
+            if(bracketed){
+                // The minimizer of the cubic that interpolates the ends, kept away from them.
+                double d1 = loSlope + hiSlope - 3 * (loValue - hiValue) / (lo - hi),
+                    d2 = d1 * d1 - loSlope * hiSlope, width = hi - lo;
+                step = lo + width / 2;
+                if(d2 >= 0){
+                    d2 = (hi > lo ? 1 : -1) * sqrt(d2);
+                    double cubic = hi - width * (hiSlope + d2 - d1) / (hiSlope - loSlope + 2 * d2);
+                    if(isfinite(cubic))
+                        step = min(max(cubic, min(lo, hi) + 0.1 * fabs(width)), max(lo, hi) - 0.1 * fabs(width));
+                }
+            }
+
+            next.weights = start.weights;
+            for(size_t j = 0; j < direction.size(); ++j)
+                next.weights[j] += step * direction[j];
+            evaluate(next);
+            double slope = dot(next.gradient, direction);
+
+            if(next.value > start.value + SUFFICIENT_DECREASE * step * slope0 || next.value >= loValue){
+                hi = step; hiValue = next.value; hiSlope = slope;
+                bracketed = true;
+                continue;
+            }
+            if(fabs(slope) <= -curvature * slope0)
+                return true;
+
+            if(bracketed && slope * (hi - lo) >= 0){
+                hi = lo; hiValue = loValue; hiSlope = loSlope;
+            }
+            else if(!bracketed && slope >= 0){
+                hi = lo; hiValue = loValue; hiSlope = loSlope;
+                bracketed = true;
+            }
+            lo = step; loValue = next.value; loSlope = slope;
+            swap(best, next);
+            if(!bracketed)  step *= 2;
+        }
+
+        // Without the curvature condition, the best step that lowered the objective is taken.
+        if(lo == 0) return false;
+        swap(best, next);
+        step = lo;
+        return true;
+    }
+
+    /**
+     * @brief Takes a step of Levenberg-Marquardt. The jacobian J of the outputs gives the gradient of the objective,
+     *        J^T * r / N plus the L2 term, and its Gauss-Newton hessian H, J^T * J / N plus the L2 term. The step
+     *        solves (H + damping * I) * step = -gradient with a Cholesky factorization and it is taken if it lowers
+     *        the objective, otherwise the damping grows and the step is solved again. The damping is updated with
+     *        the ratio between the actual decrease and the one predicted by the quadratic model (Nielsen).
+     *
+     * @param evaluate - The function that evaluates the objective (without its gradient) at the weights of a point.
+     * @param net - The network.
+     * @param set - The training set.
+     * @param regularized - True for the weights that are not biases.
+     * @param lambda - The L2 term.
+     * @param damping - The damping, 0 to choose it from the hessian.
+     * @param growth - The factor by which the damping grows after a rejected step.
+     * @param curr - The current point, its gradient is computed.
+     * @param next - The point found.
+     * @return bool - True if a step has been taken, false if the gradient is below the tolerance or no damping
+     *                lowered the objective.
+     */
+    bool FullBatchTrainer::dampedStep(const function<void(point &p)> &evaluate, Network &net, const dataSet &set,
+                                        const vector<bool> &regularized, const double lambda, double &damping,
+                                        double &growth, point &curr, point &next) const{
+        const size_t n = curr.weights.size(), N = set.results.size();
+        vector<double> jacobian, hessian(n * n), factor, step(n);
+
+        net.setFlatWeights(curr.weights);
+        net.computeJacobian(set, Network::nullEstimator, jacobian);
+
+        // The gradient and the lower triangle of the hessian, one row of the jacobian (a residual) at a time.
+        curr.gradient.assign(n, 0);
+        for(size_t p = 0, r = 0; p < N; ++p){
+            for(size_t o = 0; o < curr.outputs[p].size(); ++o, ++r){
+                const double *row = jacobian.data() + r * n, residual = curr.outputs[p][o] - set.results[p][o];
+
+                for(size_t a = 0; a < n; ++a){
+                    if(row[a] == 0) continue;
+                    double *h = hessian.data() + a * n;
+                    curr.gradient[a] += row[a] * residual;
+                    for(size_t b = 0; b <= a; ++b)
+                        h[b] += row[a] * row[b];
+                }
+            }
+        }
+        for(size_t a = 0; a < n; ++a){
+            curr.gradient[a] = curr.gradient[a] / N + (regularized[a] ? lambda * curr.weights[a] : 0);
+            for(size_t b = 0; b <= a; ++b)
+                hessian[a * n + b] /= N;
+            if(regularized[a])  hessian[a * n + a] += lambda;
+        }
+
+        if(all_of(curr.gradient.begin(), curr.gradient.end(),
+                    [this](const double g){ return fabs(g) <= this->tolerance; }))
+            return false;
+
+        if(damping == 0)
+            for(size_t a = 0; a < n; ++a)
+                damping = max(damping, 1e-3 * hessian[a * n + a]);
+
+        for(size_t i = 0; i < MAX_EVALUATIONS; ++i){
+            factor = hessian;
+            for(size_t a = 0; a < n; ++a)
+                factor[a * n + a] += damping;
+
+            if(cholesky(factor, n)){
+                for(size_t a = 0; a < n; ++a)
+                    step[a] = -curr.gradient[a];
+                choleskySolve(factor, n, step);
+
+                next.weights = curr.weights;
+                for(size_t a = 0; a < n; ++a)
+                    next.weights[a] += step[a];
+                evaluate(next);
+
+                // The decrease predicted by the quadratic model is step^T * (damping * step - gradient) / 2.
+                double predicted = 0;
+                for(size_t a = 0; a < n; ++a)
+                    predicted += step[a] * (damping * step[a] - curr.gradient[a]) / 2;
+                double gain = (curr.value - next.value) / predicted;
+
+                if(predicted > 0 && gain > 0){
+                    damping *= max(1. / 3, 1 - pow(2 * gain - 1, 3));
+                    growth = 2;
+                    return true;
+                }
+            }
+
+            damping *= growth;
+            growth *= 2;
+        }
+
+        return false;
+    }
+
+    // COMPUTATION
+
+    /**
+     * @brief Trains the network using the training set passed as input (see the two sets version).
+     *
+     * @param net - The network to train.
+     * @param trainingSet - The training set.
+     * @param est - The Estimator of the training set.
+     * @param hyperPar - The hyperparameters.
+     */
+    void FullBatchTrainer::train(Network &net, const dataSet &trainingSet, Estimator &est,
+                                    const parameters &hyperPar) const{
+        this->train(net, trainingSet, dataSet{}, est, Network::nullEstimator, hyperPar);
+    }
+
+    /**
+     * @brief Trains the network using the training set passed as input. Of the hyperparameters, max_epoch is the
+     *        maximum number of iterations and lambda the L2 term, while eval_step, eval_size and keep_best are used
+     *        as in Network::train. The mini-batch is always the whole training set, and eta, mi and the update are
+     *        not used. The training stops before max_epoch if the gradient is below the tolerance or if no step
+     *        lowers the objective anymore.
+     *
+     * @param net - The network to train.
+     * @param trainingSet - The training set.
+     * @param testSet - The test set.
+     * @param trainEst - The Estimator for the training set.
+     * @param testEst - The Estimator for the test set.
+     * @param hyperPar - The hyperparameters.
+     */
+    void FullBatchTrainer::train(Network &net, const dataSet &trainingSet, const dataSet &testSet,
+                                    Estimator &trainEst, Estimator &testEst, const parameters &hyperPar) const{
+        if(trainingSet.results.empty())
+            throw invalid_argument("The training set is empty.");
+
+        const size_t N = trainingSet.results.size(), n = net.getWeightsNumber();
+        const vector<size_t> sizes = net.getlayersSizes();
+        const vector<size_t> testPatt = Network::evaluationSubset(testSet.results.size(), hyperPar.eval_size);
+        const double lambda = hyperPar.lambda;
+        vector<bool> regularized;
+        regularized.reserve(n);
+        for(size_t l = 0; l + 1 < sizes.size(); ++l)
+            for(size_t j = 0; j < sizes[l + 1]; ++j)
+                for(size_t i = 0; i <= sizes[l]; ++i)
+                    regularized.push_back(i < sizes[l]);
+
+        const loss_func &usedLoss = this->type == LEVENBERG_MARQUARDT ? loss_func{halfSquaredError} : this->loss;
+        Recorder recorder{usedLoss};
+        auto objective = [&](point &p){
+            double penalty = 0;
+
+            net.setFlatWeights(p.weights);
+            recorder.total = 0;
+            recorder.outputs.clear();
+            net.computeGradient(trainingSet, recorder, p.gradient);
+
+            for(size_t i = 0; i < n; ++i){
+                p.gradient[i] /= N;
+                if(regularized[i]){
+                    p.gradient[i] += lambda * p.weights[i];
+                    penalty += p.weights[i] * p.weights[i];
+                }
+            }
+            p.value = recorder.total / N + lambda * penalty / 2;
+            swap(p.outputs, recorder.outputs);
+        };
+        // The objective without the gradient, for Levenberg-Marquardt.
+        auto value = [&](point &p){
+            double penalty = 0;
+
+            net.setFlatWeights(p.weights);
+            recorder.total = 0;
+            recorder.outputs.clear();
+            for(size_t i = 0; i < N; ++i)
+                recorder.update(net.compute(trainingSet, i), trainingSet.results[i]);
+
+            for(size_t i = 0; i < n; ++i)
+                if(regularized[i])  penalty += p.weights[i] * p.weights[i];
+            p.value = recorder.total / N + lambda * penalty / 2;
+            swap(p.outputs, recorder.outputs);
+        };
+
+        point curr, next;
+        curr.weights = net.getFlatWeights();
+        objective(curr);
+
+        // The corrections of L-BFGS, in a circular buffer, and the previous iteration of the conjugate gradient.
+        vector<vector<double>> s(this->memory), y(this->memory);
+        vector<double> rho(this->memory), alpha(this->memory), direction(n), prevGradient, sNew(n), yNew(n);
+        size_t stored = 0, newest = 0, done = 0, bestEpoch = 0;
+        double prevStep = 0, prevSlope = 0, damping = 0, growth = 2;
+        bool restart = true, stop = false, hasBest = false;
+        vector<double> evaluated, best;
+
+        for(size_t epoch = 0; epoch < hyperPar.max_epoch && !stop && !trainEst.stoppingCriteria(); ++epoch){
+            // Evaluate the test set only if the estimator is going to use it.
+            bool evaluate = hyperPar.eval_step > 0 && epoch % hyperPar.eval_step == 0 && testEst.toEvaluate(epoch);
+            done = epoch + 1;
+
+            trainEst.init(epoch);
+            if(evaluate)    testEst.init(epoch);
+
+            // The outputs of the current weights have been computed by the last evaluation of the objective.
+            for(size_t i = 0; i < N; ++i)
+                trainEst.update(curr.outputs[i], trainingSet.results[i]);
+            if(evaluate){
+                net.setFlatWeights(curr.weights);
+                if(hyperPar.keep_best)  evaluated = curr.weights;
+                for(size_t j = 0; j < testPatt.size(); ++j)
+                    testEst.update(net.compute(testSet, testPatt[j]), testSet.results[testPatt[j]]);
+            }
+
+            stop = this->type != LEVENBERG_MARQUARDT && all_of(curr.gradient.begin(), curr.gradient.end(),
+                                                        [this](const double g){ return fabs(g) <= this->tolerance; });
+            if(this->type == LEVENBERG_MARQUARDT){
+                if(this->dampedStep(value, net, trainingSet, regularized, lambda, damping, growth, curr, next))
+                    swap(curr, next);
+                else
+                    stop = true;
+            }
+            else if(!stop){
+                // Compute the direction.
+                if(this->type == LBFGS){
+                    direction = curr.gradient;
+                    for(size_t k = 0; k < stored; ++k){
+                        size_t i = (newest + this->memory - k) % this->memory;
+                        alpha[i] = rho[i] * dot(s[i], direction);
+                        for(size_t j = 0; j < n; ++j)   direction[j] -= alpha[i] * y[i][j];
+                    }
+                    double gamma = stored > 0 ? dot(s[newest], y[newest]) / dot(y[newest], y[newest]) : 1;
+                    for(double &d : direction)  d *= gamma;
+                    for(size_t k = stored; k-- > 0;){
+                        size_t i = (newest + this->memory - k) % this->memory;
+                        double beta = rho[i] * dot(y[i], direction);
+                        for(size_t j = 0; j < n; ++j)   direction[j] += (alpha[i] - beta) * s[i][j];
+                    }
+                    for(double &d : direction)  d = -d;
+                }
+                else{
+                    // Polak-Ribiere+, that restarts along the gradient when beta would be negative.
+                    double beta = 0;
+                    if(!restart){
+                        for(size_t j = 0; j < n; ++j)
+                            beta += curr.gradient[j] * (curr.gradient[j] - prevGradient[j]);
+                        beta = max(beta / dot(prevGradient, prevGradient), 0.);
+                    }
+                    for(size_t j = 0; j < n; ++j)
+                        direction[j] = -curr.gradient[j] + beta * direction[j];
+                }
+
+                double slope = dot(curr.gradient, direction);
+                if(slope >= 0){
+                    for(size_t j = 0; j < n; ++j)   direction[j] = -curr.gradient[j];
+                    slope = dot(curr.gradient, direction);
+                    restart = true;
+                }
+
+                // The first step of the line search: the L-BFGS directions are already scaled, while the conjugate
+                // gradient expects the same decrease of the last iteration.
+                double step = 1;
+                if(restart || (this->type == LBFGS && stored == 0))  step = min(1., 1 / sqrt(-slope));
+                else if(this->type == CG)                           step = prevStep * prevSlope / slope;
+
+                if(this->lineSearch(objective, curr, direction, step, next)){
+                    if(this->type == LBFGS){
+                        for(size_t j = 0; j < n; ++j){
+                            sNew[j] = next.weights[j] - curr.weights[j];
+                            yNew[j] = next.gradient[j] - curr.gradient[j];
+                        }
+                        // Store the correction only if it keeps the approximation positive definite.
+                        double sy = dot(sNew, yNew);
+                        if(sy > 1e-10 * sqrt(dot(sNew, sNew) * dot(yNew, yNew))){
+                            newest = stored == 0 ? 0 : (newest + 1) % this->memory;
+                            swap(s[newest], sNew); swap(y[newest], yNew);
+                            sNew.resize(n); yNew.resize(n);
+                            rho[newest] = 1 / sy;
+                            stored = min(stored + 1, this->memory);
+                        }
+                    }
+                    prevStep = step;
+                    prevSlope = slope;
+                    prevGradient = curr.gradient;
+                    restart = false;
+                    swap(curr, next);
+                }
+                // If not even the gradient lowers the objective, there is nothing more to do.
+                else if(restart)
+                    stop = true;
+                else{
+                    stored = 0;
+                    restart = true;
+                }
+            }
+
+            trainEst.plot();
+            if(evaluate)    testEst.plot();
+
+            // Keep the evaluated weights if they are the best ones.
+            if(evaluate && hyperPar.keep_best && testEst.isBest()){
+                swap(evaluated, best);
+                hasBest = true;
+                bestEpoch = epoch;
+            }
+        }
+
+        net.setFlatWeights(hasBest ? best : curr.weights);
+        net.setTrained(hasBest ? bestEpoch : done, hasBest);
+        trainEst.terminate(); testEst.terminate();
+    }
+}
@@ -0,0 +1,92 @@
+/*******************************************************
+ *                                                     *
+ *  sann: Neural Network library                       *
+ *                                                     *
+ *  FULL BATCH TRAINER CLASS HEADER                    *
+ *                                                     *
+ *  Giulio Auriemma                                    *
+ *                                                     *
+ *******************************************************/
+
+#ifndef S_FULL_BATCH_TRAINER_S
+#define S_FULL_BATCH_TRAINER_S
+
+// System libraries include.
+#include <vector>
+#include <functional>
+
+// My includes.
+#include "dataStructures.h"
+#include "Network.hpp"
+#include "Estimator.hpp"
+
+namespace sann{
+
+/// This class trains a network on the whole training set at every iteration, with a quasi-Newton method (L-BFGS),
+/// with the nonlinear conjugate gradient (Polak-Ribiere+) or with Levenberg-Marquardt. The first two take the step
+/// along their direction with a line search that satisfies the strong Wolfe conditions. Levenberg-Marquardt solves
+/// the damped Gauss-Newton system built from the jacobian of the outputs: it needs a matrix with the square of the
+/// number of weights, so it is meant for small nets, where it converges in a few tens of iterations. The minimized
+/// objective is the mean loss on the training set plus lambda / 2 times the squared weights (the biases are not
+/// regularized), and its gradient is the one of Network::computeGradient: so the loss must be the one whose opposite
+/// derivative is the error function of the net (Levenberg-Marquardt always uses half the squared error).
+/// It is an alternative to Network::train for the full-batch problems, with the same contract for the estimators:
+/// every iteration is an epoch, in which the training estimator sees the outputs of the weights at its start.
+class FullBatchTrainer{
+public:
+    // ENUMERATION
+
+    enum method{LBFGS, CG, LEVENBERG_MARQUARDT};
+
+    // TYPEDEF
+
+    typedef std::function<double(const std::vector<double> &target, const std::vector<double> &out)> loss_func;
+
+private:
+    // STRUCT
+
+    /// The weights at which the objective has been evaluated, with its value, its gradient and the outputs of the
+    /// training patterns.
+    struct point{
+        std::vector<double> weights, gradient;
+        double value;
+        std::vector<std::vector<double>> outputs;
+    };
+
+    // ATTRIBUTES
+
+    method type;
+    std::size_t memory = 10;    // The number of corrections kept by L-BFGS.
+    double tolerance = 1e-6;    // The training stops when all the components of the gradient are below it.
+    loss_func loss;
+
+    // METHODS
+
+    bool lineSearch(const std::function<void(point &p)> &evaluate, const point &start,
+                    const std::vector<double> &direction, double &step, point &next) const;
+    bool dampedStep(const std::function<void(point &p)> &evaluate, Network &net, const sann::dataSet &set,
+                    const std::vector<bool> &regularized, const double lambda, double &damping, double &growth,
+                    point &curr, point &next) const;
+
+public:
+    // CONSTRUCTORS
+
+    FullBatchTrainer(const method type = LBFGS);
+
+    // METHODS
+
+    void setMemory(const std::size_t m);
+    void setTolerance(const double tolerance);
+    void setLoss(const loss_func &loss);
+
+    // COMPUTATION
+
+    void train(Network &net, const sann::dataSet &trainingSet, sann::Estimator &est,
+                const sann::parameters &hyperPar) const;
+    void train(Network &net, const sann::dataSet &trainingSet, const sann::dataSet &testSet,
+                sann::Estimator &trainEst, sann::Estimator &testEst, const sann::parameters &hyperPar) const;
+};
+
+}
+
+#endif
@@ -12,6 +12,7 @@
 
 // Other system includes.
 #include <stdexcept>
+#include <algorithm>
 
 // Debug includes.
 #ifdef S_DEBUG_MODE_S
@@ -20,13 +21,56 @@
 
 using namespace std;
 
+const size_t BLOCK = 4; // The rows computed together by the dense kernels.
+
 namespace sann{
 
+    /**
+     * @brief Computes the product between the first n columns of a matrix and a vector. The rows are computed
+     *        BLOCK at a time, with one accumulator each, so every element of the vector is loaded once per block
+     *        instead of once per row. Each product is still summed in the order of the columns, so the result
+     *        does not depend on the blocking.
+     * 
+     * @param matrix - The matrix, each row must have at least n columns.
+     * @param x - The vector.
+     * @param n - The size of the vector.
+     * @param out - The result, one element per row.
+     */
+    static void blockedProduct(const weightsMatrix &matrix, const double *x, const size_t n, double *out){
+        const size_t rows = matrix.size(), blocked = rows - rows % BLOCK;
+
+        for(size_t i = 0; i < blocked; i += BLOCK){
+            const double *w0 = matrix[i].data(), *w1 = matrix[i + 1].data(), 
+                *w2 = matrix[i + 2].data(), *w3 = matrix[i + 3].data();
+            double n0 = 0, n1 = 0, n2 = 0, n3 = 0;
+
+            for(size_t j = 0; j < n; ++j){
+                const double xj = x[j];
+                n0 += xj * w0[j];
+                n1 += xj * w1[j];
+                n2 += xj * w2[j];
+                n3 += xj * w3[j];
+            }
+            out[i] = n0;
+            out[i + 1] = n1;
+            out[i + 2] = n2;
+            out[i + 3] = n3;
+        }
+
+        // The rows left out of the blocks.
+        for(size_t i = blocked; i < rows; ++i){
+            double acc = 0;
+            for(size_t j = 0; j < n; ++j)
+                acc += x[j] * matrix[i][j];
+            out[i] = acc;
+        }
+    }
+
     /**
      * @brief Creates an empty layer.
      * 
      */
-    Layer::Layer() : level(0), neurons(0), lastNet({}), func(math::Func::sigmoid) { }
+    Layer::Layer() : level(0), neurons(0), lastNet({}), lastOut({}), func(math::Func::sigmoid) { }
 
     /**
      * @brief Instantiate a layer with n neurons with the same activation function and no weights.
@@ -37,7 +81,7 @@ namespace sann{
      */
     Layer::Layer(const size_t numOfNeurons, const math::Func &activationFunc, const short level) : 
         level(level), neurons(numOfNeurons), lastNet(vector<double>(numOfNeurons)), 
-        func(activationFunc){
+        lastOut(vector<double>(numOfNeurons)), func(activationFunc){
         this->weights.resize(numOfNeurons);
     }
 
@@ -48,7 +92,8 @@ namespace sann{
      */
     Layer::Layer(const Layer &lay) : level(lay.level), neurons(lay.neurons), weights(weightsMatrix{lay.weights}),
         currErrors(weightsMatrix{lay.currErrors}), prevErrors(weightsMatrix{lay.prevErrors}), 
-        lastNet(vector<double>(neurons)), func(lay.func){}
+        lastNet(vector<double>(neurons)), lastOut(vector<double>(neurons)), func(lay.func), 
+        transpose(lay.transpose){}
 
     /**
      * @brief Sets the weight of the layer.
@@ -67,6 +112,7 @@ namespace sann{
         
         this->currErrors = weightsMatrix{neurons, vector<double>(step)};
         this->prevErrors = weightsMatrix{neurons, vector<double>(step)};
+        this->transposedStale = true;
     }
 
     /**
@@ -81,6 +127,7 @@ namespace sann{
         this->weights = weights;
         this->currErrors = weightsMatrix{neurons, vector<double>(weights[0].size())};
         this->prevErrors = weightsMatrix{neurons, vector<double>(weights[0].size())};
+        this->transposedStale = true;
     }
 
     /**
@@ -95,6 +142,7 @@ namespace sann{
         this->weights = move(weights);
         this->currErrors = weightsMatrix{neurons, vector<double>(this->weights[0].size())};
         this->prevErrors = weightsMatrix{neurons, vector<double>(this->weights[0].size())};
+        this->transposedStale = true;
     }
 
     /**
@@ -112,6 +160,85 @@ namespace sann{
         this->weights = move(newWeights);
         this->currErrors = weightsMatrix{neurons, vector<double>(weights[0].size())};
         this->prevErrors = weightsMatrix{neurons, vector<double>(weights[0].size())};
+        this->transposedStale = true;
+    }
+
+    /**
+     * @brief Copies the weights of a layer with the same shape. The weights are copied inside the buffers
+     *        already allocated and the errors are left untouched, so it is cheap enough to be done every epoch.
+     * 
+     * @param lay - The layer from which copy the weights.
+     */
+    void Layer::copyWeights(const Layer &lay){
+        this->copyWeights(lay.weights);
+    }
+
+    /**
+     * @brief Copies a weights matrix with the same shape of the current one inside the buffers already allocated.
+     * 
+     * @param weights - The weights to copy.
+     */
+    void Layer::copyWeights(const weightsMatrix &weights){
+        if(weights.size() != this->weights.size())
+            throw invalid_argument("The shapes of the two weights matrices do not match.");
+
+        for(size_t i = 0; i < this->weights.size(); ++i){
+            if(weights[i].size() != this->weights[i].size())
+                throw invalid_argument("The shapes of the two weights matrices do not match.");
+            copy(weights[i].begin(), weights[i].end(), this->weights[i].begin());
+        }
+        this->transposedStale = true;
+    }
+
+    /**
+     * @brief Copies the weights from a flat array, in which the row of each neuron (the weights of the inputs followed
+     *        by the bias) is contiguous. The buffers already allocated are reused.
+     * 
+     * @param weights - The flat weights, as many as the ones of the layer.
+     */
+    void Layer::copyWeights(const double *weights){
+        for(vector<double> &row : this->weights){
+            copy(weights, weights + row.size(), row.begin());
+            weights += row.size();
+        }
+        this->transposedStale = true;
+    }
+
+    /**
+     * @brief Copies the weights in a flat array, with the row of each neuron contiguous.
+     * 
+     * @param weights - The flat array, with room for all the weights of the layer.
+     */
+    void Layer::copyWeightsTo(double *weights) const{
+        for(const vector<double> &row : this->weights)
+            weights = copy(row.begin(), row.end(), weights);
+    }
+
+    /**
+     * @brief Moves the errors accumulated by the back propagation in a flat array, with the row of each neuron
+     *        contiguous, and resets them. They are the opposite of the gradient of the error of the patterns.
+     * 
+     * @param errors - The flat array, with room for an error for each weight of the layer.
+     */
+    void Layer::takeErrors(double *errors){
+        for(vector<double> &row : this->currErrors){
+            errors = copy(row.begin(), row.end(), errors);
+            fill(row.begin(), row.end(), 0);
+        }
+    }
+
+    /**
+     * @brief Chooses whether the back propagation keeps a transposed copy of the weights. The errors of the
+     *        previous layer are then computed as dot products over its rows, that have unit stride and need no
+     *        store per neuron. The copy is refreshed only when the weights changed since the last back
+     *        propagation, so it pays off with large mini-batches and wide layers.
+     * 
+     * @param keep - True to keep the transposed copy, false to free it.
+     */
+    void Layer::setTransposedWeights(const bool keep){
+        this->transpose = keep;
+        this->transposedStale = true;
+        if(!keep)   weightsMatrix{}.swap(this->transposed);
     }
 
     /**
@@ -123,6 +250,15 @@ namespace sann{
         return this->weights;
     }
 
+    /**
+     * @brief Returns the activation function of the neurons.
+     * 
+     * @return const math::Func& - The activation function.
+     */
+    const math::Func& Layer::getFunction() const{
+        return this->func;
+    }
+
     /**
      * @brief Returns the number of neurons.
      * 
@@ -133,70 +269,262 @@ namespace sann{
     }
 
     /**
-     * @brief Computes the net function for a given inputs value.
+     * @brief Computes the net function for a given inputs value (see blockedProduct).
      * 
      * @param inputs - The inputs.
      * @return vector<double> - The vector of the result of net function for each neuron.
      */
-    vector<double> Layer::computeNets(vector<double> inputs) const{
+    vector<double> Layer::computeNets(const vector<double> &inputs) const{
+        vector<double> nets(neurons);
+
+        blockedProduct(this->weights, inputs.data(), inputs.size(), nets.data());
+        for(size_t i = 0; i < neurons; ++i)
+            nets[i] += this->weights[i].back(); // The bias.
+
+        return nets;
+    }
+
+    /**
+     * @brief Computes the net function for a sparse input, whose only non-zero inputs are equal to 1. The net of
+     *        each neuron is the sum of the weights of the active inputs, so the zeros are never touched.
+     * 
+     * @param active - The indexes of the active inputs.
+     * @return vector<double> - The vector of the result of net function for each neuron.
+     */
+    vector<double> Layer::computeSparseNets(const vector<size_t> &active) const{
         vector<double> nets(neurons);
 
         for(size_t i = 0; i < neurons; ++i){
-            for(size_t j = 0; j < inputs.size(); ++j)
-                nets[i] += inputs[j] * this->weights[i][j];
-            nets[i] += this->weights[i].back();
+            const vector<double> &row = this->weights[i];
+            for(size_t k = 0; k < active.size(); ++k)
+                nets[i] += row[active[k]];
+            nets[i] += row.back();
         }
 
         return nets;
     }
 
+    /**
+     * @brief Applies the activation function to the last nets. The outputs are kept too, so the back propagation
+     *        can compute the derivative from them without evaluating the function again.
+     * 
+     * @return std::vector<double> - The vector of outputs of the current layer.
+     */
+    vector<double> Layer::activate(){
+        this->lastOut.resize(neurons);
+
+        // Compute the output for each neuron.
+        for(size_t i = 0; i < neurons; ++i)
+            this->lastOut[i] = this->func.call(this->lastNet[i]);
+
+        return this->lastOut;
+    }
+
+    /**
+     * @brief Returns the derivative of the activation function of a neuron in the last computed point, using its
+     *        output when the function allows it.
+     * 
+     * @param neuron - The neuron.
+     * @return double - The derivative.
+     */
+    inline double Layer::derivative(const size_t neuron) const{
+        return this->func.hasOutputDerivative() ? this->func.outputDerivative(this->lastOut[neuron]) : 
+                                                    this->func.derivative(this->lastNet[neuron]);
+    }
+
     /**
      * @brief Computes the vector of outputs of the current layer. When this method is call, the result of the
-     *        net function is stored inside the object to do not recompute it later during back propagation. So
-     *        be careful in introducing network parallelization (for small net is not even necessary since -O3
-     *        optimization flag is sufficient).
+     *        net function and the outputs are stored inside the object to do not recompute them later during back
+     *        propagation. So be careful in introducing network parallelization (for small net is not even necessary
+     *        since -O3 optimization flag is sufficient).
      * 
      * @param inputs - The inputs from the previous layer.
      * @return std::vector<double> - The vector of outputs of the current layer.
      */
     vector<double> Layer::feed_forward(const vector<double> &inputs){
-        vector<double> outputs; 
-        outputs.reserve(neurons);
-        this->lastNet = move(this->computeNets(inputs));
+        this->lastNet = this->computeNets(inputs);
+        return this->activate();
+    }
 
-        // Compute the output for each neuron.
-        for(size_t i = 0; i < neurons; ++i)
-            outputs.push_back(this->func.call(this->lastNet[i]));
+    /**
+     * @brief Computes the vector of outputs of the current layer for a sparse input (see computeSparseNets).
+     * 
+     * @param active - The indexes of the inputs equal to 1.
+     * @return std::vector<double> - The vector of outputs of the current layer.
+     */
+    vector<double> Layer::feed_forward_sparse(const vector<size_t> &active){
+        this->lastNet = this->computeSparseNets(active);
+        return this->activate();
+    }
+
+    /**
+     * @brief Computes the delta of each neuron from the errors of the next layer.
+     * 
+     * @param errors - The errors of the next layer.
+     */
+    void Layer::computeDeltas(const vector<double> &errors){
+        this->deltas.resize(neurons);
+        for(size_t j = 0; j < neurons; ++j)
+            this->deltas[j] = this->derivative(j) * errors[j];
+    }
+
+    /**
+     * @brief Adds the gradient of the last pattern, i.e. the outer product between the deltas and the inputs, to
+     *        the errors of the weights. Each row is a single streaming pass.
+     * 
+     * @param inputs - The inputs of the previous layer.
+     */
+    void Layer::accumulateGradients(const vector<double> &inputs){
+        const size_t n = inputs.size();
+        const double *x = inputs.data();
+
+        for(size_t j = 0; j < neurons; ++j){
+            const double delta = this->deltas[j];
+            double *g = this->currErrors[j].data();
+
+            for(size_t i = 0; i < n; ++i)
+                g[i] += delta * x[i];
+            g[n] += delta; // The bias.
+        }
+    }
 
-        return outputs;
+    /**
+     * @brief Computes the errors of the previous layer, i.e. the product between the transposed weights (without
+     *        the biases) and the deltas. With the transposed copy it is a product over its rows (see
+     *        blockedProduct), otherwise the rows of the weights are scaled and summed BLOCK at a time, so the
+     *        errors are loaded and stored once per block. In both cases every error is accumulated neuron after
+     *        neuron, so the result is the same.
+     * 
+     * @return vector<double> - The errors of the previous layer.
+     */
+    vector<double> Layer::propagateErrors(){
+        const size_t n = this->weights[0].size() - 1;
+        vector<double> layerErrors(n);
+
+        if(this->transpose){
+            if(this->transposedStale){
+                this->transposed.resize(n);
+                for(size_t i = 0; i < n; ++i){
+                    this->transposed[i].resize(neurons);
+                    for(size_t j = 0; j < neurons; ++j)
+                        this->transposed[i][j] = this->weights[j][i];
+                }
+                this->transposedStale = false;
+            }
+            blockedProduct(this->transposed, this->deltas.data(), neurons, layerErrors.data());
+            return layerErrors;
+        }
+
+        const size_t blocked = neurons - neurons % BLOCK;
+        const double *d = this->deltas.data();
+        double *e = layerErrors.data();
+
+        for(size_t j = 0; j < blocked; j += BLOCK){
+            const double d0 = d[j], d1 = d[j + 1], d2 = d[j + 2], d3 = d[j + 3];
+            const double *w0 = this->weights[j].data(), *w1 = this->weights[j + 1].data(), 
+                *w2 = this->weights[j + 2].data(), *w3 = this->weights[j + 3].data();
+
+            for(size_t i = 0; i < n; ++i){
+                double ei = e[i];
+                ei += d0 * w0[i];
+                ei += d1 * w1[i];
+                ei += d2 * w2[i];
+                ei += d3 * w3[i];
+                e[i] = ei;
+            }
+        }
+
+        // The neurons left out of the blocks.
+        for(size_t j = blocked; j < neurons; ++j){
+            const double dj = d[j], *w = this->weights[j].data();
+            for(size_t i = 0; i < n; ++i)
+                e[i] += dj * w[i];
+        }
+
+        return layerErrors;
     }
 
     /**
      * @brief Applies the algorithm of back propagation on the current layer. It's important noting that to avoid
      *        compute the error on this layer once this function would be called on previous layer, the error is
-     *        computed in the current call and then passed as argument to the previous layer.
+     *        computed in the current call and then passed as argument to the previous layer. The gradients and
+     *        the errors of the previous layer are computed by two separated kernels.
      * 
      * @param inputs - The inputs of previous layer.
      * @param errors - The errors of the next layer. On the output layer9 this is the vector of the output errors.
-     * @return std::vector<double> - The vector of errors to propagate back to previous layer.
+     * @param propagate - False if the errors of the previous layer are not needed (e.g. on the first layer).
+     * @return std::vector<double> - The vector of errors to propagate back to previous layer, empty if propagate
+     *                               is false.
      */
-    vector<double> Layer::back_propagation(const vector<double> &inputs, const vector<double> &errors){
-        vector<double> layerErrors(inputs.size());
+    vector<double> Layer::back_propagation(const vector<double> &inputs, const vector<double> &errors, 
+                                            const bool propagate){
+        this->computeDeltas(errors);
+        this->accumulateGradients(inputs);
+
+        return propagate ? this->propagateErrors() : vector<double>{};
+    }
+
+    /**
+     * @brief Applies the back propagation and updates the weights in the same sweep, as updateWeights would do
+     *        with the gradient of this pattern only. It is the online training step: the gradient is never
+     *        stored and each weight is touched once. The errors of the previous layer are computed before, with
+     *        the old weights.
+     * 
+     * @param inputs - The inputs of previous layer.
+     * @param errors - The errors of the next layer.
+     * @param hyperP - The hyperparameters.
+     * @param propagate - False if the errors of the previous layer are not needed (e.g. on the first layer).
+     * @return std::vector<double> - The vector of errors to propagate back to previous layer, empty if propagate
+     *                               is false.
+     */
+    vector<double> Layer::back_propagation_update(const vector<double> &inputs, const vector<double> &errors, 
+                                                    const sann::parameters &hyperP, const bool propagate){
+        this->computeDeltas(errors);
+        vector<double> layerErrors = propagate ? this->propagateErrors() : vector<double>{};
+        const size_t n = inputs.size();
+        const double *x = inputs.data();
 
         for(size_t j = 0; j < neurons; ++j){
-            double delta = this->func.derivative(this->lastNet[j]) * errors[j];
+            const double delta = this->deltas[j];
+            double *w = this->weights[j].data(), *prev = this->prevErrors[j].data();
 
-            // Compute the delta weights for each weight and for the bias.
-            for(size_t i = 0; i < inputs.size(); ++i){
-                this->currErrors[j][i] += delta * inputs[i];
-                layerErrors[i] += delta * this->weights[j][i]; // Update the error of the current layer.
+            for(size_t i = 0; i < n; ++i){
+                double dwi = hyperP.eta * (delta * x[i] / hyperP.mb) + hyperP.mi * prev[i];
+                w[i] += dwi - hyperP.lambda * w[i];
+                prev[i] = dwi;
             }
-            this->currErrors[j].back() += delta;
+
+            // The bias is not regularized.
+            double dwi = hyperP.eta * (delta / hyperP.mb) + hyperP.mi * prev[n];
+            w[n] += dwi;
+            prev[n] = dwi;
         }
+        this->transposedStale = true;
 
         return layerErrors;
     }
 
+    /**
+     * @brief Applies the back propagation on a layer that received a sparse input. Only the errors of the weights
+     *        of the active inputs change, so the delta of each neuron is just added to them. Since the inputs
+     *        belong to no layer, no error is propagated back.
+     * 
+     * @param active - The indexes of the inputs equal to 1.
+     * @param errors - The errors of the next layer.
+     */
+    void Layer::back_propagation_sparse(const vector<size_t> &active, const vector<double> &errors){
+        this->computeDeltas(errors);
+
+        for(size_t j = 0; j < neurons; ++j){
+            const double delta = this->deltas[j];
+            vector<double> &row = this->currErrors[j];
+
+            for(size_t k = 0; k < active.size(); ++k)
+                row[active[k]] += delta;
+            row.back() += delta;
+        }
+    }
+
     /**
      * @brief Updates the weigths of the current layer. Use the hyperparameters to compute how much the weight
      *          will change.
@@ -215,5 +543,6 @@ namespace sann{
                 this->currErrors[i][j] = 0; // Reset the error.
             }
         }
+        this->transposedStale = true;
     }
 }
\ No newline at end of file
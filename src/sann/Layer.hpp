@@ -28,13 +28,20 @@ private:
 
     short level;
     size_t neurons;
-    weightsMatrix weights, currErrors, prevErrors;
-    std::vector<double> lastNet;
+    weightsMatrix weights, currErrors, prevErrors, transposed;
+    std::vector<double> lastNet, lastOut, deltas;
     math::Func func;
+    bool transpose = false, transposedStale = true;
     
     // METHODS
 
-    std::vector<double> computeNets(std::vector<double> inputs) const;
+    std::vector<double> computeNets(const std::vector<double> &inputs) const;
+    std::vector<double> computeSparseNets(const std::vector<std::size_t> &active) const;
+    std::vector<double> activate();
+    double derivative(const std::size_t neuron) const;
+    void computeDeltas(const std::vector<double> &errors);
+    void accumulateGradients(const std::vector<double> &inputs);
+    std::vector<double> propagateErrors();
 public:
     // TYPEDEF
 
@@ -52,13 +59,25 @@ public:
     void setWeights(const weightsMatrix &weights);
     void setWeights(weightsMatrix &&weights);
     void setWeights(const weights_initializer &init, const size_t n);
+    void copyWeights(const Layer &lay);
+    void copyWeights(const weightsMatrix &weights);
+    void copyWeights(const double *weights);
+    void copyWeightsTo(double *weights) const;
+    void takeErrors(double *errors);
+    void setTransposedWeights(const bool keep);
     const weightsMatrix& getWeights() const;
+    const math::Func& getFunction() const;
     size_t getSize() const;
 
     // COMPUTATION
 
     std::vector<double> feed_forward(const std::vector<double> &inputs);
-    std::vector<double> back_propagation(const std::vector<double> &inputs, const std::vector<double> &errors);
+    std::vector<double> feed_forward_sparse(const std::vector<std::size_t> &active);
+    std::vector<double> back_propagation(const std::vector<double> &inputs, const std::vector<double> &errors, 
+                                            const bool propagate = true);
+    std::vector<double> back_propagation_update(const std::vector<double> &inputs, const std::vector<double> &errors, 
+                                                    const sann::parameters &hyperP, const bool propagate = true);
+    void back_propagation_sparse(const std::vector<std::size_t> &active, const std::vector<double> &errors);
     void updateWeights(const sann::parameters &hyperP);
 };
 
@@ -12,6 +12,13 @@
 // Other system libraries include.
 #include <stdexcept>
 #include <cmath>
+#include <numeric>
+#include <algorithm>
+#include <future>
+
+// My includes.
+#include "math/Randomizer.hpp"
+#include "math/Philox.hpp"
 
 // Debug libraries.
 #ifdef S_DEBUG_MODE_S
@@ -52,6 +59,47 @@ namespace sann{
         return errors;
     };
 
+    /**
+     * @brief Returns the indexes of the patterns of a set on which the net is evaluated. If n is 0 or greater
+     *        than the size of the set, all the patterns are chosen, otherwise n of them are randomly picked.
+     *        The indexes are in ascending order.
+     * 
+     * @param size - The size of the set.
+     * @param n - The number of patterns to pick.
+     * @return vector<size_t> - The indexes of the chosen patterns.
+     */
+    vector<size_t> Network::evaluationSubset(const size_t size, const size_t n){
+        vector<size_t> indexes(size);
+        iota(indexes.begin(), indexes.end(), 0);
+
+        if(n > 0 && n < size){
+            // Partial Fisher-Yates: the first n positions hold the picked patterns.
+            for(size_t i = 0; i < n; ++i)
+                swap(indexes[i], indexes[min(math::Randomizer::randomRange<size_t>(i, size), size - 1)]);
+            indexes.resize(n);
+            sort(indexes.begin(), indexes.end());
+        }
+
+        return indexes;
+    }
+
+    /**
+     * @brief Sets the order in which the patterns are visited in an epoch to a random permutation. The permutation
+     *        only depends on the seed and on the epoch.
+     * 
+     * @param order - The indexes of the patterns.
+     * @param seed - The seed of the shuffling.
+     * @param epoch - The epoch.
+     */
+    void Network::shuffleOrder(vector<size_t> &order, const uint64_t seed, const size_t epoch){
+        math::Philox gen{seed, epoch};
+
+        iota(order.begin(), order.end(), 0);
+        if(order.size() < 2)    return;
+        for(size_t i = order.size() - 1; i > 0; --i)
+            swap(order[i], order[(size_t)(gen.uniform() * (i + 1))]);
+    }
+
     // CONSTRUCTORS
 
     /**
@@ -111,7 +159,9 @@ namespace sann{
      *
      * @param net - The network to copy.
      */
-    Network::Network(const Network &net) : layers(net.layers), inputSize(net.inputSize), errorFunc(net.errorFunc){ }
+    Network::Network(const Network &net) : layers(net.layers), embedding(net.embedding), inputSize(net.inputSize),
+        errorFunc(net.errorFunc), best(net.best), hasBest(net.hasBest), bestEpoch(net.bestEpoch), 
+        trainedEpochs(net.trainedEpochs), restoredBest(net.restoredBest){ }
 
     /**
      * @brief Copy assignment.
@@ -119,8 +169,14 @@ namespace sann{
      */
     Network& Network::operator = (const Network &rhs){
         this->layers = rhs.layers;
+        this->embedding = rhs.embedding;
         this->inputSize = rhs.inputSize;
         this->errorFunc = rhs.errorFunc;
+        this->best = rhs.best;
+        this->hasBest = rhs.hasBest;
+        this->bestEpoch = rhs.bestEpoch;
+        this->trainedEpochs = rhs.trainedEpochs;
+        this->restoredBest = rhs.restoredBest;
 
         return *this;
     }
@@ -131,8 +187,14 @@ namespace sann{
      */
     Network& Network::operator = (Network &&rhs){
         this->layers = move(rhs.layers);
+        this->embedding = move(rhs.embedding);
         this->inputSize = rhs.inputSize;
         this->errorFunc = move(rhs.errorFunc);
+        this->best = move(rhs.best);
+        this->hasBest = rhs.hasBest;
+        this->bestEpoch = rhs.bestEpoch;
+        this->trainedEpochs = rhs.trainedEpochs;
+        this->restoredBest = rhs.restoredBest;
 
         return *this;
     }
@@ -146,8 +208,13 @@ namespace sann{
         if(weights.size() != this->layers.size())
             throw invalid_argument("The size of the weights vector and the number of layers do not agree.");
 
-        for(size_t i = 0; i < this->layers.size(); ++i)
+        for(size_t i = 0; i < this->layers.size(); ++i){
+            size_t inputs = i == 0 ? this->inputSize : this->layers[i - 1].getSize();
+            if(weights[i].size() != this->layers[i].getSize() * (inputs + 1))
+                throw invalid_argument("The weights of the layer " + to_string(i) + " must be one per input plus the "
+                                        "bias for each neuron.");
             this->layers[i].setWeights(weights[i]);
+        }
     }
 
     /**
@@ -159,8 +226,10 @@ namespace sann{
         if(weights.size() != this->layers.size())
             throw invalid_argument("The size of the weights vector and the number of layers do not agree.");
 
-        for(size_t i = 0; i < this->layers.size(); ++i)
+        for(size_t i = 0; i < this->layers.size(); ++i){
+            this->checkWeights(i, weights[i]);
             this->layers[i].setWeights(weights[i]);
+        }
     }
 
     /**
@@ -172,8 +241,10 @@ namespace sann{
         if(weights.size() != this->layers.size())
             throw invalid_argument("The size of the weights vector and the number of layers do not agree.");
 
-        for(size_t i = 0; i < this->layers.size(); ++i)
+        for(size_t i = 0; i < this->layers.size(); ++i){
+            this->checkWeights(i, weights[i]);
             this->layers[i].setWeights(move(weights[i]));
+        }
     }
 
     /**
@@ -186,6 +257,118 @@ namespace sann{
         this->errorFunc = shared_ptr<error_func>(new error_func(error));
     }
 
+    /**
+     * @brief Puts an embedding ahead of the layers. From now on the net takes as inputs the indexes of the active
+     *        categories, and the size of the output of the embedding must be the input size of the first layer.
+     * 
+     * @param embedding - The embedding.
+     */
+    void Network::setEmbedding(const Embedding &embedding){
+        if(embedding.getSize() != this->inputSize)
+            throw invalid_argument("The output size of the embedding does not match the input size of the net.");
+
+        this->embedding = embedding;
+    }
+
+    /**
+     * @brief Returns the embedding of the net, that is empty if the net has none.
+     * 
+     * @return const Embedding& - The embedding.
+     */
+    const Embedding& Network::getEmbedding() const{
+        return this->embedding;
+    }
+
+    /**
+     * @brief Chooses whether the layers keep a transposed copy of their weights for the back propagation (see
+     *        Layer::setTransposedWeights). It is worth it with large mini-batches and wide layers.
+     * 
+     * @param keep - True to keep the transposed copies, false to free them.
+     */
+    void Network::setTransposedWeights(const bool keep){
+        for(Layer &layer : this->layers)
+            layer.setTransposedWeights(keep);
+    }
+
+    /**
+     * @brief Copies the weights of a network with the same topology, reusing the buffers of the current one.
+     * 
+     * @param net - The network from which copy the weights.
+     */
+    void Network::copyWeights(const Network &net){
+        if(net.layers.size() != this->layers.size())
+            throw invalid_argument("The topologies of the two networks do not match.");
+
+        for(size_t i = 0; i < this->layers.size(); ++i)
+            this->layers[i].copyWeights(net.layers[i]);
+        if(!this->embedding.empty())    this->embedding.copyTable(net.embedding.getTable());
+    }
+
+    /**
+     * @brief Copies the weights of the network in a vector of matrices. If the vector has already the right shape,
+     *        its buffers are reused and nothing is allocated. The table of the embedding, if any, is the last matrix.
+     * 
+     * @param weights - The vector in which copy the weights.
+     */
+    void Network::copyWeightsTo(vector<weightsMatrix> &weights) const{
+        weights.resize(this->layers.size() + (this->embedding.empty() ? 0 : 1));
+
+        for(size_t i = 0; i < weights.size(); ++i){
+            const weightsMatrix &layWeights = i < this->layers.size() ? this->layers[i].getWeights() : 
+                                                this->embedding.getTable();
+            weights[i].resize(layWeights.size());
+
+            for(size_t j = 0; j < layWeights.size(); ++j)
+                weights[i][j].assign(layWeights[j].begin(), layWeights[j].end());
+        }
+    }
+
+    /**
+     * @brief Restores the best weights kept during the last training with the keep_best parameter.
+     * 
+     * @return bool - True if there were some weights to restore.
+     */
+    bool Network::restoreBest(){
+        if(!this->hasBest)  return false;
+
+        for(size_t i = 0; i < this->layers.size(); ++i)
+            this->layers[i].copyWeights(this->best[i]);
+        if(!this->embedding.empty())    this->embedding.copyTable(this->best.back());
+
+        return true;
+    }
+
+    /**
+     * @brief Records how the current weights have been trained.
+     * 
+     * @param epochs - The epochs trained by the weights.
+     * @param best - True if they are the best weights kept by the training.
+     */
+    void Network::setTrained(const size_t epochs, const bool best){
+        this->trainedEpochs = epochs;
+        this->restoredBest = best;
+    }
+
+    /**
+     * @brief Returns the epochs trained by the current weights in the last training. When the best weights have
+     *        been restored (see keep_best) they are the epochs done before the evaluation of those weights, i.e.
+     *        the epoch of the training estimator whose weights have been kept.
+     * 
+     * @return size_t - The epochs.
+     */
+    size_t Network::getTrainedEpochs() const{
+        return this->trainedEpochs;
+    }
+
+    /**
+     * @brief Returns true if the current weights are the best ones kept by the last training (see keep_best).
+     * 
+     * @return bool - True if the best weights have been restored.
+     */
+    bool Network::hasRestoredBest() const{
+        return this->restoredBest;
+    }
+
     /**
      * @brief Returns a vector with the matrix of weights of each layer.
      * 
@@ -215,6 +398,58 @@ namespace sann{
         return sizes;
     } 
 
+    /**
+     * @brief Returns the number of weights of the layers, biases included.
+     * 
+     * @return size_t - The number of weights.
+     */
+    size_t Network::getWeightsNumber() const{
+        size_t number = 0, inputs = this->inputSize;
+
+        for(const Layer &layer : this->layers){
+            number += layer.getSize() * (inputs + 1);
+            inputs = layer.getSize();
+        }
+
+        return number;
+    }
+
+    /**
+     * @brief Returns the weights of the layers in a single vector: the layers follow one another and in each layer
+     *        the row of each neuron (the weights of the inputs followed by the bias) is contiguous. The table of the
+     *        embedding is not included.
+     * 
+     * @return vector<double> - The flat weights.
+     */
+    vector<double> Network::getFlatWeights() const{
+        vector<double> weights(this->getWeightsNumber());
+        double *out = weights.data();
+
+        for(const Layer &layer : this->layers){
+            layer.copyWeightsTo(out);
+            out += layer.getSize() * layer.getWeights()[0].size();
+        }
+
+        return weights;
+    }
+
+    /**
+     * @brief Sets the weights of the layers from a single vector laid out as the one of getFlatWeights. The buffers
+     *        already allocated are reused, so it is cheap enough to be done at every step of an optimizer.
+     * 
+     * @param weights - The flat weights.
+     */
+    void Network::setFlatWeights(const vector<double> &weights){
+        if(weights.size() != this->getWeightsNumber())
+            throw invalid_argument("The number of flat weights does not match the one of the network.");
+
+        const double *in = weights.data();
+        for(Layer &layer : this->layers){
+            layer.copyWeights(in);
+            in += layer.getSize() * layer.getWeights()[0].size();
+        }
+    }
+
     // COMPUTATION
 
     /** 
@@ -224,6 +459,8 @@ namespace sann{
      * @return std::vector<double> - The outputs computed by the network.
      */
     vector<double> Network::compute(const vector<double> &inputs){
+        if(!this->embedding.empty())
+            throw invalid_argument("A net with an embedding only takes the indexes of the active categories.");
         if(inputs.size() != this->inputSize)
             throw invalid_argument("The inputs size does not match the expected one.");
 
@@ -235,39 +472,343 @@ namespace sann{
         return output;
     }
 
+    /** 
+     * @brief Computes the result for a sparse input, given by the indexes of the inputs equal to 1.
+     *
+     * @param active - The indexes of the active inputs.
+     * @return std::vector<double> - The outputs computed by the network.
+     */
+    vector<double> Network::computeSparse(const vector<size_t> &active){
+        this->checkActive(active);
+
+        if(!this->embedding.empty()){
+            vector<double> output = this->embedding.feed_forward(active);
+
+            for(size_t i = 0; i < this->layers.size(); ++i)
+                output = this->layers[i].feed_forward(output);
+
+            return output;
+        }
+
+        vector<double> output = this->layers[0].feed_forward_sparse(active);
+
+        for(size_t i = 1; i < this->layers.size(); ++i)
+            output = this->layers[i].feed_forward(output);
+
+        return output;
+    }
+
+    /** 
+     * @brief Computes the result for a pattern of a data set, that can be either dense or sparse.
+     *
+     * @param set - The data set.
+     * @param i - The index of the pattern.
+     * @return std::vector<double> - The outputs computed by the network.
+     */
+    vector<double> Network::compute(const dataSet &set, const size_t i){
+        return set.isSparse() ? this->computeSparse(set.active[i]) : this->compute(set.inputs[i]);
+    }
+
     // TRAIN
 
+    /**
+     * @brief Checks that a weights matrix has a column for each input of the layer plus one for the bias.
+     *
+     * @param layer - The index of the layer.
+     * @param weights - The weights matrix.
+     */
+    void Network::checkWeights(const size_t layer, const weightsMatrix &weights) const{
+        size_t inputs = layer == 0 ? this->inputSize : this->layers[layer - 1].getSize();
+
+        for(const vector<double> &row : weights)
+            if(row.size() != inputs + 1)
+                throw invalid_argument("The weights of the layer " + to_string(layer) + " must have a column for each "
+                                        "input plus the bias.");
+    }
+
+    /**
+     * @brief Checks that the indexes of a sparse input are inside the inputs of the net, or inside the categories
+     *        of the embedding if it has one.
+     *
+     * @param active - The indexes of the active inputs.
+     */
+    void Network::checkActive(const vector<size_t> &active) const{
+        size_t size = this->embedding.empty() ? this->inputSize : this->embedding.getCategories();
+
+        for(size_t k = 0; k < active.size(); ++k)
+            if(active[k] >= size)
+                throw invalid_argument("The active input " + to_string(active[k]) + " is out of the inputs size.");
+    }
+
     /**
      * @brief The train step for a single pattern.
      *
      * @param trainPattern - The pattern of the training set.
      * @param expectedResults - The expected result.
      * @param est - The Estimator for the training set.
+     * @param online - If not null, the layers are updated during the backward step with these hyperparameters.
      */
-    void Network::trainStep(const vector<double> &trainPattern, const vector<double> &expectedResults, Estimator &est){
+    void Network::trainStep(const vector<double> &trainPattern, const vector<double> &expectedResults, Estimator &est,
+                                const parameters *online){
+        if(!this->embedding.empty())
+            throw invalid_argument("A net with an embedding only takes the indexes of the active categories.");
         if(trainPattern.size() != this->inputSize)
             throw invalid_argument("The train pattern size does not match the input one.");
 
         vector<vector<double>> outputs = {trainPattern};
+        vector<double> errors;
         outputs.reserve(this->layers.size() + 1);
 
         // Feed forward.
-        for(size_t i = 0; i < this->layers.size(); ++i)
-            outputs.push_back(this->layers[i].feed_forward(outputs.back()));
+        {
+            S_PROFILE_SCOPE(this->timings, FORWARD);
+            for(size_t i = 0; i < this->layers.size(); ++i)
+                outputs.push_back(this->layers[i].feed_forward(outputs.back()));
+        }
 
         auto results = outputs.back();
         // Check if the expected results have the right size.
         if(results.size() != expectedResults.size())
             throw invalid_argument("The results size does not match the expected one.");
 
-        est.update(results, expectedResults); // Update the estimator.
-        
-        // Compute output errors for back propagation.
-        vector<double> errors = (*this->errorFunc)(expectedResults, results);
+        {
+            S_PROFILE_SCOPE(this->timings, LOSS);
+            est.update(results, expectedResults); // Update the estimator.
+            
+            // Compute output errors for back propagation.
+            errors = (*this->errorFunc)(expectedResults, results);
+        }
 
         // Compute the backward step.
+        // The errors of the inputs are not needed, so the first layer does not compute them.
+        S_PROFILE_SCOPE(this->timings, BACKWARD);
         for(short i = this->layers.size() - 1; i >= 0; i--)
-            errors = this->layers[i].back_propagation(outputs[i], errors);
+            errors = online ? this->layers[i].back_propagation_update(outputs[i], errors, *online, i > 0) :
+                                this->layers[i].back_propagation(outputs[i], errors, i > 0);
+    }
+
+    /**
+     * @brief The train step for a single sparse pattern. The first layer gathers the weights of the active inputs
+     *        in the forward step and scatters the deltas on them in the backward one. If the net has an embedding,
+     *        the rows of the active categories are the inputs of the first layer and only they are trained.
+     *
+     * @param active - The indexes of the inputs of the pattern equal to 1.
+     * @param expectedResults - The expected result.
+     * @param est - The Estimator for the training set.
+     * @param online - If not null, the dense layers are updated during the backward step with these
+     *                 hyperparameters. The first layer without embedding is left to updateWeights.
+     */
+    void Network::trainStep(const vector<size_t> &active, const vector<double> &expectedResults, Estimator &est,
+                                const parameters *online){
+        this->checkActive(active);
+
+        if(!this->embedding.empty()){
+            vector<vector<double>> outputs;
+            vector<double> errors;
+            {
+                S_PROFILE_SCOPE(this->timings, FORWARD);
+                outputs.reserve(this->layers.size() + 1);
+                outputs.push_back(this->embedding.feed_forward(active));
+                for(size_t i = 0; i < this->layers.size(); ++i)
+                    outputs.push_back(this->layers[i].feed_forward(outputs.back()));
+            }
+
+            if(outputs.back().size() != expectedResults.size())
+                throw invalid_argument("The results size does not match the expected one.");
+
+            {
+                S_PROFILE_SCOPE(this->timings, LOSS);
+                est.update(outputs.back(), expectedResults);
+                errors = (*this->errorFunc)(expectedResults, outputs.back());
+            }
+
+            S_PROFILE_SCOPE(this->timings, BACKWARD);
+            for(short i = this->layers.size() - 1; i >= 0; i--)
+                errors = online ? this->layers[i].back_propagation_update(outputs[i], errors, *online) :
+                                    this->layers[i].back_propagation(outputs[i], errors);
+            this->embedding.back_propagation(active, errors);
+            return;
+        }
+
+        vector<vector<double>> outputs;
+        vector<double> errors;
+        outputs.reserve(this->layers.size());
+
+        // Feed forward.
+        {
+            S_PROFILE_SCOPE(this->timings, FORWARD);
+            outputs.push_back(this->layers[0].feed_forward_sparse(active));
+            for(size_t i = 1; i < this->layers.size(); ++i)
+                outputs.push_back(this->layers[i].feed_forward(outputs.back()));
+        }
+
+        auto results = outputs.back();
+        // Check if the expected results have the right size.
+        if(results.size() != expectedResults.size())
+            throw invalid_argument("The results size does not match the expected one.");
+
+        {
+            S_PROFILE_SCOPE(this->timings, LOSS);
+            est.update(results, expectedResults); // Update the estimator.
+            
+            // Compute output errors for back propagation.
+            errors = (*this->errorFunc)(expectedResults, results);
+        }
+
+        // Compute the backward step, the outputs of the layer i are the inputs of the layer i + 1.
+        S_PROFILE_SCOPE(this->timings, BACKWARD);
+        for(size_t i = this->layers.size() - 1; i > 0; i--)
+            errors = online ? this->layers[i].back_propagation_update(outputs[i - 1], errors, *online) :
+                                this->layers[i].back_propagation(outputs[i - 1], errors);
+        this->layers[0].back_propagation_sparse(active, errors);
+    }
+
+    /**
+     * @brief Trains the network for one epoch. The patterns are visited through their indexes, so the data set is
+     *        never moved, and the next pattern is prefetched while the current one is trained. In online mode
+     *        (mini-batches of one pattern) the dense layers are updated during the backward step, so their
+     *        gradients are never stored.
+     *
+     * @param trainingSet - The training set.
+     * @param order - The order in which the patterns are visited.
+     * @param mb - The size of the mini-batches.
+     * @param est - The Estimator for the training set.
+     * @param hyperPar - The hyperparameters.
+     */
+    void Network::trainEpoch(const dataSet &trainingSet, const vector<size_t> &order, const size_t mb, Estimator &est,
+                                const parameters &hyperPar){
+        const parameters *online = mb == 1 ? &hyperPar : nullptr;
+        const bool sparseFirst = trainingSet.isSparse() && this->embedding.empty();
+
+        for(size_t i = 0; i < order.size() / mb; ++i){
+            auto end = i == order.size() / mb - 1 ? order.size() : ((i + 1) * mb);
+
+            // Compute the back propagation step for a group of patterns.
+            for(size_t j = i * mb; j < end; ++j){
+                if(trainingSet.isSparse()){
+                    if(j + 1 < order.size())    __builtin_prefetch(trainingSet.active[order[j + 1]].data());
+                    this->trainStep(trainingSet.active[order[j]], trainingSet.results[order[j]], est, online);
+                }
+                else{
+                    if(j + 1 < order.size())    __builtin_prefetch(trainingSet.inputs[order[j + 1]].data());
+                    this->trainStep(trainingSet.inputs[order[j]], trainingSet.results[order[j]], est, online);
+                }
+            }
+
+            // Update the weights.
+            S_PROFILE_SCOPE(this->timings, UPDATE);
+            for(size_t j = 0; j < this->layers.size(); ++j)
+                if(!online || (j == 0 && sparseFirst))
+                    this->layers[j].updateWeights(hyperPar);
+            if(!this->embedding.empty())    this->embedding.updateWeights(hyperPar);
+        }
+    }
+
+    /**
+     * @brief Computes the gradient of the error summed on all the patterns of a set, with the layout of
+     *        getFlatWeights. The error is the one whose opposite derivative wrt the outputs is the error function
+     *        (half the squared error for the default one). The weights are not changed.
+     * 
+     * @param set - The data set.
+     * @param est - The Estimator that sees the output of each pattern.
+     * @param gradient - The vector in which the gradient is written.
+     */
+    void Network::computeGradient(const dataSet &set, Estimator &est, vector<double> &gradient){
+        if(!this->embedding.empty())
+            throw invalid_argument("The gradient of a network with an embedding is not supported.");
+        if(set.inputs.size() != set.results.size() || (set.isSparse() && set.active.size() != set.results.size()))
+            throw invalid_argument("The size of the set patterns and of the expected results do not match.");
+
+        for(size_t i = 0; i < set.results.size(); ++i){
+            if(set.isSparse())  this->trainStep(set.active[i], set.results[i], est);
+            else                this->trainStep(set.inputs[i], set.results[i], est);
+        }
+
+        gradient.resize(this->getWeightsNumber());
+        double *out = gradient.data();
+        for(Layer &layer : this->layers){
+            layer.takeErrors(out);
+            out += layer.getSize() * layer.getWeights()[0].size();
+        }
+        for(double &g : gradient)
+            g = -g;
+    }
+
+    /**
+     * @brief Computes the jacobian of the outputs of all the patterns of a set wrt the weights: the row of the
+     *        output o of the pattern p is the index p * outputs + o, and the columns have the layout of
+     *        getFlatWeights. Each pattern is fed forward once and then back propagated once for each output,
+     *        with a unit error on it. The weights are not changed.
+     * 
+     * @param set - The data set.
+     * @param est - The Estimator that sees the output of each pattern.
+     * @param jacobian - The vector in which the jacobian is written, row by row.
+     */
+    void Network::computeJacobian(const dataSet &set, Estimator &est, vector<double> &jacobian){
+        if(!this->embedding.empty())
+            throw invalid_argument("The jacobian of a network with an embedding is not supported.");
+        if(set.inputs.size() != set.results.size() || (set.isSparse() && set.active.size() != set.results.size()))
+            throw invalid_argument("The size of the set patterns and of the expected results do not match.");
+
+        const size_t n = this->getWeightsNumber(), outputs = this->layers.back().getSize();
+        vector<vector<double>> layerInputs(this->layers.size());
+        jacobian.resize(set.results.size() * outputs * n);
+
+        for(size_t p = 0; p < set.results.size(); ++p){
+            // Feed forward, the outputs of the layer i - 1 are the inputs of the layer i.
+            vector<double> results;
+            if(set.isSparse()){
+                this->checkActive(set.active[p]);
+                results = this->layers[0].feed_forward_sparse(set.active[p]);
+            }
+            else{
+                if(set.inputs[p].size() != this->inputSize)
+                    throw invalid_argument("The pattern size does not match the input one.");
+                layerInputs[0] = set.inputs[p];
+                results = this->layers[0].feed_forward(set.inputs[p]);
+            }
+            for(size_t i = 1; i < this->layers.size(); ++i){
+                layerInputs[i] = move(results);
+                results = this->layers[i].feed_forward(layerInputs[i]);
+            }
+
+            if(results.size() != set.results[p].size())
+                throw invalid_argument("The results size does not match the expected one.");
+            est.update(results, set.results[p]);
+
+            for(size_t o = 0; o < outputs; ++o){
+                vector<double> errors(outputs, 0);
+                errors[o] = 1;
+
+                for(size_t i = this->layers.size() - 1; i > 0; i--)
+                    errors = this->layers[i].back_propagation(layerInputs[i], errors);
+                if(set.isSparse())  this->layers[0].back_propagation_sparse(set.active[p], errors);
+                else                this->layers[0].back_propagation(layerInputs[0], errors, false);
+
+                double *row = jacobian.data() + (p * outputs + o) * n;
+                for(Layer &layer : this->layers){
+                    layer.takeErrors(row);
+                    row += layer.getSize() * layer.getWeights()[0].size();
+                }
+            }
+        }
+    }
+
+    /**
+     * @brief Calls the checkpoint of the hyperparameters if the epoch is one of their checkpoints. It must be called
+     *        at the start of the epoch, so the net is the one that a training with max_epoch = epoch would return.
+     *
+     * @param hyperPar - The hyperparameters.
+     * @param epoch - The epoch.
+     */
+    void Network::reachCheckpoint(const parameters &hyperPar, const size_t epoch) const{
+        if(!hyperPar.checkpoint || !binary_search(hyperPar.checkpoints.begin(), hyperPar.checkpoints.end(), epoch))
+            return;
+
+        Network net{*this};
+        const bool best = hyperPar.keep_best && net.restoreBest();
+        net.setTrained(best ? this->bestEpoch : epoch, best);
+        hyperPar.checkpoint(net, epoch);
     }
 
     /**
@@ -278,33 +819,40 @@ namespace sann{
      * @param hyperPar - The hyperparameters.
      */
     void Network::train(const dataSet &trainingSet, Estimator &est, const parameters &hyperPar){
-        if(trainingSet.inputs.size() != trainingSet.results.size())
+        if(trainingSet.inputs.size() != trainingSet.results.size() || 
+            (trainingSet.isSparse() && trainingSet.active.size() != trainingSet.results.size()))
             throw invalid_argument("The size of training set patterns and of the expected results do not match.");
 
         parameters currPars = hyperPar;
-        size_t epoch;
-        vector<vector<double>> myTrainPatterns(trainingSet.inputs);
+        vector<size_t> order(trainingSet.inputs.size());
+        size_t epoch, mb_size = max<size_t>(1, currPars.mb <= order.size() ? currPars.mb : order.size());
+        this->hasBest = false;  // Without a test set no weights are kept.
+        iota(order.begin(), order.end(), 0);
 
         for(epoch = 0; epoch < hyperPar.max_epoch && !est.stoppingCriteria(); ++epoch){
-            est.init(epoch);
+#ifdef S_PROFILE_MODE_S
+            this->timings.fill(0);
+#endif
+            this->reachCheckpoint(currPars, epoch);
+            {
+                S_PROFILE_SCOPE(this->timings, ESTIMATOR);
+                est.init(epoch);
+            }
             currPars.update(currPars, epoch); // Update the hyper-parameter.
 
-            for(size_t i = 0; i < myTrainPatterns.size() / hyperPar.mb; ++i){
-                auto end = i == myTrainPatterns.size() / hyperPar.mb - 1 ?
-                            myTrainPatterns.size() : ((i + 1) * hyperPar.mb);
-
-                // Compute the back propagation step for a group of patterns.
-                for(size_t j = i * hyperPar.mb; j < end; ++j)
-                    this->trainStep(myTrainPatterns[j], trainingSet.results[j], est);
+            if(currPars.shuffle)    shuffleOrder(order, currPars.shuffle_seed, epoch);
+            this->trainEpoch(trainingSet, order, mb_size, est, currPars);
 
-                // Update the weights.
-                for(size_t j = 0; j < this->layers.size(); ++j)
-                    this->layers[j].updateWeights(hyperPar);
+            {
+                S_PROFILE_SCOPE(this->timings, ESTIMATOR);
+                est.plot();
             }
-
-            est.plot();
+#ifdef S_PROFILE_MODE_S
+            est.profile(epoch, this->timings);
+#endif
         }
 
+        this->setTrained(epoch, false);
         est.terminate();
     }
 
@@ -319,40 +867,88 @@ namespace sann{
      */
     void Network::train(const dataSet &trainingSet, const dataSet &testSet, Estimator &trainEst, Estimator &testEst, 
                             const parameters &hyperPar){
-        if(trainingSet.inputs.size() != trainingSet.results.size())
+        if(trainingSet.inputs.size() != trainingSet.results.size() || 
+            (trainingSet.isSparse() && trainingSet.active.size() != trainingSet.results.size()))
             throw invalid_argument("The size of training set patterns and of the expected results do not match.");
 
         parameters currPars = hyperPar;
-        vector<vector<double>> trainPatt{trainingSet.inputs}, trainRes{trainingSet.results};
-        size_t epoch, mb_size = currPars.mb <= trainPatt.size() ? currPars.mb : trainPatt.size();
+        vector<size_t> order(trainingSet.inputs.size());
+        vector<size_t> testPatt = evaluationSubset(testSet.inputs.size(), currPars.eval_size);
+        size_t epoch, mb_size = max<size_t>(1, currPars.mb <= order.size() ? currPars.mb : order.size());
+        // The copy of the net on which the test set is asynchronously evaluated.
+        Network snapshot = currPars.eval_async ? Network{*this} : Network{};
+        this->hasBest = false;
+        iota(order.begin(), order.end(), 0);
+
+        // Compute test errors and accuracy.
+        auto evaluateTest = [&testSet, &testPatt, &testEst](Network &net){
+            for(size_t j = 0; j < testPatt.size(); ++j){
+                vector<double> res = net.compute(testSet, testPatt[j]);
+                testEst.update(res, testSet.results[testPatt[j]]);
+            }
+        };
 
         for(epoch = 0; epoch < currPars.max_epoch && !trainEst.stoppingCriteria(); ++epoch){
-            trainEst.init(epoch); testEst.init(epoch);
+            // Evaluate the test set only if the estimator is going to use it.
+#ifdef S_PROFILE_MODE_S
+            this->timings.fill(0);
+#endif
+            this->reachCheckpoint(currPars, epoch);
+            bool evaluate;
+            {
+                S_PROFILE_SCOPE(this->timings, ESTIMATOR);
+                evaluate = currPars.eval_step > 0 && epoch % currPars.eval_step == 0 && testEst.toEvaluate(epoch);
+
+                trainEst.init(epoch); 
+                if(evaluate)    testEst.init(epoch);
+            }
             currPars.update(currPars, epoch); // Update the hyper-parameter.
 
-            // Compute test errors and accuracy.
-            for(size_t j = 0; j < testSet.inputs.size(); ++j){
-                vector<double> res = this->compute(testSet.inputs[j]);
-                testEst.update(res, testSet.results[j]);
+            // The asynchronous evaluation works on a snapshot of the current weights, so it can overlap the
+            // training of the epoch. It is joined before the plot, so the estimator sees the same outputs.
+            future<void> evaluation;
+            {
+                S_PROFILE_SCOPE(this->timings, VALIDATION);
+                if(evaluate && currPars.eval_async){
+                    snapshot.copyWeights(*this);
+                    evaluation = async(launch::async, evaluateTest, ref(snapshot));
+                }
+                else if(evaluate){
+                    if(currPars.keep_best)  this->copyWeightsTo(this->evaluated);
+                    evaluateTest(*this);
+                }
             }
 
-            // Check again the stopping criteria due to the fact that the test estimator could have change it.
-            for(size_t i = 0; i < trainPatt.size() / mb_size; ++i){
-                auto end = i == trainPatt.size() / mb_size - 1 ?
-                            trainPatt.size() : ((i + 1) * mb_size);
+            if(currPars.shuffle)    shuffleOrder(order, currPars.shuffle_seed, epoch);
+            this->trainEpoch(trainingSet, order, mb_size, trainEst, currPars);
 
-                // Compute the back propagation step for a group of patterns.
-                for(size_t j = i * mb_size; j < end; ++j)
-                    this->trainStep(trainPatt[j], trainRes[j], trainEst);
+            {
+                // Only the time spent waiting for the asynchronous evaluation is counted.
+                S_PROFILE_SCOPE(this->timings, VALIDATION);
+                if(evaluation.valid())  evaluation.get();
+            }
 
-                // Update the weights.
-                for(size_t j = 0; j < this->layers.size(); ++j)
-                    this->layers[j].updateWeights(currPars);
+            {
+                S_PROFILE_SCOPE(this->timings, ESTIMATOR);
+                trainEst.plot(); 
+                if(evaluate)    testEst.plot();
             }
 
-            trainEst.plot(); testEst.plot();
+            // Keep the evaluated weights if they are the best ones.
+            if(evaluate && currPars.keep_best && testEst.isBest()){
+                S_PROFILE_SCOPE(this->timings, VALIDATION);
+                if(currPars.eval_async) snapshot.copyWeightsTo(this->best);
+                else                    swap(this->evaluated, this->best);
+                this->hasBest = true;
+                this->bestEpoch = epoch;
+            }
+#ifdef S_PROFILE_MODE_S
+            trainEst.profile(epoch, this->timings);
+#endif
         }
 
+        const bool best = currPars.keep_best && this->restoreBest();
+        this->setTrained(best ? this->bestEpoch : epoch, best);
         trainEst.terminate(); testEst.terminate();
     }
 }
\ No newline at end of file
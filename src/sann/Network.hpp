@@ -16,26 +16,49 @@
 
 // My include
 #include "Layer.hpp"
+#include "Embedding.hpp"
 #include "Estimator.hpp"
 #include "math/Func.hpp"
 #include "math/Plotter.hpp"
+#include "utility/Profiler.hpp"
 
 namespace sann{
 
 /// This is the core class, that represents the whole Neural Network.
 class Network{
+    friend class NetworkBatch;
+    friend class FullBatchTrainer;
 private:
     // ATTRIBUTES
 
     std::vector<Layer> layers;
+    Embedding embedding;    // The optional embedding of the categorical inputs, ahead of the layers.
     size_t inputSize;
     std::shared_ptr<std::function<std::vector<double>(const std::vector<double> &target, 
         const std::vector<double> &out)>> errorFunc;
+    std::vector<weightsMatrix> evaluated, best; // The snapshots of the weights for the keep_best parameter.
+    bool hasBest = false;
+    std::size_t bestEpoch = 0;      // The epochs trained by the best weights.
+    std::size_t trainedEpochs = 0;  // The epochs trained by the current weights in the last training.
+    bool restoredBest = false;      // True if the current weights are the best ones of the last training.
+#ifdef S_PROFILE_MODE_S
+    utility::Profiler::timings timings;     // The time spent in each phase of the current epoch.
+#endif
 
     // METHODS
     
+    static std::vector<std::size_t> evaluationSubset(const std::size_t size, const std::size_t n);
+    static void shuffleOrder(std::vector<std::size_t> &order, const uint64_t seed, const std::size_t epoch);
+    void checkActive(const std::vector<std::size_t> &active) const;
+    void checkWeights(const std::size_t layer, const weightsMatrix &weights) const;
     void trainStep(const std::vector<double> &trainPattern, const std::vector<double> &expectedResults, 
-                                    sann::Estimator &est);
+                                    sann::Estimator &est, const sann::parameters *online = nullptr);
+    void trainStep(const std::vector<std::size_t> &active, const std::vector<double> &expectedResults, 
+                                    sann::Estimator &est, const sann::parameters *online = nullptr);
+    void trainEpoch(const sann::dataSet &trainingSet, const std::vector<std::size_t> &order, const std::size_t mb,
+                                    sann::Estimator &est, const sann::parameters &hyperPar);
+    void reachCheckpoint(const sann::parameters &hyperPar, const std::size_t epoch) const;
+    void setTrained(const std::size_t epochs, const bool best);
 
 public:
     // STATIC ATTRIBUTES
@@ -64,16 +87,31 @@ public:
     void setWeights(std::vector<weightsMatrix> &&weights);
     void setRandomWeights();
     void setErrorFunction(const error_func &error);
+    void setEmbedding(const Embedding &embedding);
+    const Embedding& getEmbedding() const;
+    void setTransposedWeights(const bool keep);
+    void copyWeights(const Network &net);
+    void copyWeightsTo(std::vector<weightsMatrix> &weights) const;
+    bool restoreBest();
     std::vector<weightsMatrix> getWeights() const;
     std::vector<std::size_t> getlayersSizes() const;
+    std::size_t getWeightsNumber() const;
+    std::vector<double> getFlatWeights() const;
+    void setFlatWeights(const std::vector<double> &weights);
+    std::size_t getTrainedEpochs() const;
+    bool hasRestoredBest() const;
 
     // Computation
     std::vector<double> compute(const std::vector<double> &inputs);
+    std::vector<double> computeSparse(const std::vector<std::size_t> &active);
+    std::vector<double> compute(const sann::dataSet &set, const std::size_t i);
 
     // Train.
     void train(const sann::dataSet &trainingSet, sann::Estimator &est, const sann::parameters &hyperPar);
     void train(const sann::dataSet &trainingSet, const sann::dataSet &testSet, sann::Estimator &trainEst,
                 sann::Estimator &testEst, const sann::parameters &hyperPar);
+    void computeGradient(const sann::dataSet &set, sann::Estimator &est, std::vector<double> &gradient);
+    void computeJacobian(const sann::dataSet &set, sann::Estimator &est, std::vector<double> &jacobian);
 };
 
 }
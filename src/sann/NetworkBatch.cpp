@@ -0,0 +1,502 @@
+/*******************************************************
+ *                                                     *
+ *  sann: Neural Network library                       *
+ *                                                     *
+ *  NETWORK BATCH CLASS FILE                           *
+ *                                                     *
+ *  Giulio Auriemma                                    *
+ *                                                     *
+ *******************************************************/
+
+#include "NetworkBatch.hpp"
+
+// Other system includes.
+#include <stdexcept>
+#include <numeric>
+#include <algorithm>
+#include <iterator>
+
+// My includes.
+#include "math/Randomizer.hpp"
+
+using namespace std;
+
+namespace sann{
+
+    /**
+     * @brief Copies the values of a candidate from a stacked array to another one with the same shape.
+     *
+     * @param from - The array from which copy.
+     * @param to - The array to which copy.
+     * @param k - The candidate.
+     * @param candidates - The number of candidates.
+     */
+    static void copyCandidate(const vector<double> &from, vector<double> &to, const size_t k, const size_t candidates){
+        for(size_t i = k; i < from.size(); i += candidates)
+            to[i] = from[i];
+    }
+
+    // CONSTRUCTORS
+
+    /**
+     * @brief Stacks the weights of some networks with the same topology. The nets are copied, so they are not
+     *        changed by the training (see getNetwork).
+     *
+     * @param nets - The networks, they can have different weights but must have the same layers.
+     */
+    NetworkBatch::NetworkBatch(const vector<Network> &nets) : candidates(nets.size()){
+        if(nets.empty())
+            throw invalid_argument("A batch needs at least one network.");
+
+        const vector<size_t> sizes = nets[0].getlayersSizes();
+        for(const Network &net : nets)
+            if(net.getlayersSizes() != sizes || !net.embedding.empty())
+                throw invalid_argument("The networks of a batch must have the same layers and no embedding.");
+
+        const size_t K = this->candidates;
+        this->model = nets[0];
+        this->input.resize(sizes[0] * K);
+        this->eta.resize(K);
+        this->trained.assign(K, 0);
+        this->restored.assign(K, false);
+        this->mi.resize(K);
+        this->lambda.resize(K);
+
+        for(size_t l = 0; l < this->model.layers.size(); ++l){
+            const Layer &layer = this->model.layers[l];
+            const size_t neurons = layer.getSize(), n = layer.getWeights()[0].size() - 1, row = (n + 1) * K;
+            stackedLayer stacked{neurons, n, layer.getFunction(), vector<double>(neurons * row),
+                                    vector<double>(neurons * row), vector<double>(neurons * row),
+                                    vector<double>(neurons * K), vector<double>(neurons * K),
+                                    vector<double>(neurons * K)};
+
+            for(size_t k = 0; k < K; ++k){
+                const weightsMatrix &weights = nets[k].layers[l].getWeights();
+                for(size_t j = 0; j < neurons; ++j)
+                    for(size_t i = 0; i <= n; ++i)
+                        stacked.weights[j * row + i * K + k] = weights[j][i];
+            }
+
+            this->layers.push_back(move(stacked));
+        }
+    }
+
+    // METHODS
+
+    /**
+     * @brief Returns the number of candidates.
+     *
+     * @return size_t - The number of candidates.
+     */
+    size_t NetworkBatch::size() const{
+        return this->candidates;
+    }
+
+    /**
+     * @brief Returns a candidate as a network with its current weights.
+     *
+     * @param k - The candidate.
+     * @return Network - The network.
+     */
+    Network NetworkBatch::getNetwork(const size_t k) const{
+        if(k >= this->candidates)
+            throw out_of_range("The batch has no candidate " + to_string(k) + ".");
+
+        vector<const vector<double>*> stacked;
+        for(const stackedLayer &layer : this->layers)
+            stacked.push_back(&layer.weights);
+
+        Network net = this->unstack(stacked, k);
+        net.setTrained(this->trained[k], this->restored[k]);
+        return net;
+    }
+
+    /**
+     * @brief Builds the network of a candidate from some stacked weights.
+     *
+     * @param stacked - The stacked weights of each layer, laid out as the ones of the layers.
+     * @param k - The candidate.
+     * @return Network - The network.
+     */
+    Network NetworkBatch::unstack(const vector<const vector<double>*> &stacked, const size_t k) const{
+        const size_t K = this->candidates;
+        Network net{this->model};
+        vector<weightsMatrix> weights(this->layers.size());
+
+        for(size_t l = 0; l < this->layers.size(); ++l){
+            const stackedLayer &layer = this->layers[l];
+            const size_t row = (layer.inputs + 1) * K;
+
+            weights[l] = weightsMatrix(layer.neurons, vector<double>(layer.inputs + 1));
+            for(size_t j = 0; j < layer.neurons; ++j)
+                for(size_t i = 0; i <= layer.inputs; ++i)
+                    weights[l][j][i] = (*stacked[l])[j * row + i * K + k];
+        }
+        net.setWeights(move(weights));
+
+        return net;
+    }
+
+    // COMPUTATION
+
+    /**
+     * @brief Loads a pattern of a data set as the input of all the candidates. A sparse pattern is expanded, so
+     *        the candidates always work on dense inputs.
+     *
+     * @param set - The data set.
+     * @param i - The index of the pattern.
+     */
+    void NetworkBatch::loadInput(const dataSet &set, const size_t i){
+        const size_t K = this->candidates, n = this->layers[0].inputs;
+
+        if(set.isSparse()){
+            this->model.checkActive(set.active[i]);
+            fill(this->input.begin(), this->input.end(), 0);
+            for(size_t a : set.active[i])
+                fill(this->input.begin() + a * K, this->input.begin() + (a + 1) * K, 1);
+            return;
+        }
+
+        const vector<double> &pattern = set.inputs[i];
+        if(pattern.size() != n)
+            throw invalid_argument("The pattern size does not match the input one.");
+        for(size_t j = 0; j < n; ++j)
+            fill(this->input.begin() + j * K, this->input.begin() + (j + 1) * K, pattern[j]);
+    }
+
+    /**
+     * @brief Computes the outputs of all the candidates for the loaded input. The nets and the outputs of each layer
+     *        are kept for the back propagation. Each net is summed in the same order of Layer::feed_forward.
+     *
+     */
+    void NetworkBatch::feed_forward(){
+        const size_t K = this->candidates;
+
+        for(size_t l = 0; l < this->layers.size(); ++l){
+            stackedLayer &layer = this->layers[l];
+            const size_t n = layer.inputs, row = (n + 1) * K;
+            const double *x = l == 0 ? this->input.data() : this->layers[l - 1].outs.data();
+
+            for(size_t j = 0; j < layer.neurons; ++j){
+                double *acc = layer.nets.data() + j * K;
+                const double *w = layer.weights.data() + j * row;
+
+                fill(acc, acc + K, 0);
+                for(size_t i = 0; i < n; ++i){
+                    const double *xi = x + i * K, *wi = w + i * K;
+                    for(size_t k = 0; k < K; ++k)
+                        acc[k] += xi[k] * wi[k];
+                }
+                for(size_t k = 0; k < K; ++k)
+                    acc[k] += w[n * K + k]; // The bias.
+            }
+
+            for(size_t idx = 0; idx < layer.nets.size(); ++idx)
+                layer.outs[idx] = layer.func.call(layer.nets[idx]);
+        }
+    }
+
+    /**
+     * @brief Returns the last output of a candidate.
+     *
+     * @param k - The candidate.
+     * @return vector<double> - The output.
+     */
+    vector<double> NetworkBatch::getOutput(const size_t k) const{
+        const stackedLayer &last = this->layers.back();
+        vector<double> out(last.neurons);
+
+        for(size_t o = 0; o < last.neurons; ++o)
+            out[o] = last.outs[o * this->candidates + k];
+
+        return out;
+    }
+
+    /**
+     * @brief Back propagates the output errors of all the candidates, adding the gradients of the last pattern to
+     *        the errors of the weights. The deltas and the errors are computed in the same order of
+     *        Layer::back_propagation.
+     *
+     */
+    void NetworkBatch::back_propagation(){
+        const size_t K = this->candidates;
+
+        for(size_t l = this->layers.size(); l-- > 0;){
+            stackedLayer &layer = this->layers[l];
+            const size_t n = layer.inputs, row = (n + 1) * K;
+            const double *x = l == 0 ? this->input.data() : this->layers[l - 1].outs.data();
+
+            for(size_t idx = 0; idx < layer.deltas.size(); ++idx)
+                layer.deltas[idx] = (layer.func.hasOutputDerivative() ? layer.func.outputDerivative(layer.outs[idx]) :
+                                        layer.func.derivative(layer.nets[idx])) * this->errors[idx];
+
+            // Compute the delta weights for each weight and for the bias.
+            for(size_t j = 0; j < layer.neurons; ++j){
+                const double *d = layer.deltas.data() + j * K;
+                double *g = layer.currErrors.data() + j * row;
+
+                for(size_t i = 0; i < n; ++i){
+                    const double *xi = x + i * K;
+                    double *gi = g + i * K;
+                    for(size_t k = 0; k < K; ++k)
+                        gi[k] += d[k] * xi[k];
+                }
+                for(size_t k = 0; k < K; ++k)
+                    g[n * K + k] += d[k];
+            }
+
+            // The errors of the inputs are not needed.
+            if(l == 0)  break;
+
+            this->prevErrors.assign(n * K, 0);
+            for(size_t j = 0; j < layer.neurons; ++j){
+                const double *d = layer.deltas.data() + j * K, *w = layer.weights.data() + j * row;
+
+                for(size_t i = 0; i < n; ++i){
+                    const double *wi = w + i * K;
+                    double *ei = this->prevErrors.data() + i * K;
+                    for(size_t k = 0; k < K; ++k)
+                        ei[k] += d[k] * wi[k];
+                }
+            }
+            swap(this->errors, this->prevErrors);
+        }
+    }
+
+    /**
+     * @brief Updates the weights of all the candidates, each one with its own hyperparameters (see
+     *        Layer::updateWeights). The candidates with null hyperparameters are left unchanged.
+     *
+     * @param mb - The size of the mini-batch.
+     */
+    void NetworkBatch::updateWeights(const size_t mb){
+        const size_t K = this->candidates;
+        const double *eta = this->eta.data(), *mi = this->mi.data(), *lambda = this->lambda.data();
+
+        for(stackedLayer &layer : this->layers){
+            const size_t n = layer.inputs, row = (n + 1) * K;
+
+            for(size_t j = 0; j < layer.neurons; ++j){
+                for(size_t i = 0; i <= n; ++i){
+                    double *w = layer.weights.data() + j * row + i * K, *g = layer.currErrors.data() + j * row + i * K,
+                        *p = layer.prevErrors.data() + j * row + i * K;
+
+                    // The bias is not regularized.
+                    if(i == n){
+                        for(size_t k = 0; k < K; ++k){
+                            double dwi = eta[k] * (g[k] / mb) + mi[k] * p[k];
+                            w[k] += dwi;
+                            p[k] = dwi;
+                            g[k] = 0;
+                        }
+                        continue;
+                    }
+
+                    for(size_t k = 0; k < K; ++k){
+                        double dwi = eta[k] * (g[k] / mb) + mi[k] * p[k];
+                        w[k] += dwi - lambda[k] * w[k];
+                        p[k] = dwi;
+                        g[k] = 0;
+                    }
+                }
+            }
+        }
+    }
+
+    /**
+     * @brief Computes the output of a candidate for a pattern of a data set.
+     *
+     * @param set - The data set.
+     * @param i - The index of the pattern.
+     * @param k - The candidate.
+     * @return vector<double> - The output.
+     */
+    vector<double> NetworkBatch::compute(const dataSet &set, const size_t i, const size_t k){
+        if(k >= this->candidates)
+            throw out_of_range("The batch has no candidate " + to_string(k) + ".");
+
+        this->loadInput(set, i);
+        this->feed_forward();
+        return this->getOutput(k);
+    }
+
+    /**
+     * @brief Trains all the candidates, each one as Network::train would do with its estimators and hyperparameters.
+     *        The candidates must share the mini-batch size and the evaluation and shuffling parameters, so they see
+     *        the patterns in the same order. The test set is always evaluated synchronously. Each candidate picks
+     *        its own patterns of the test set (see parameters::eval_size) from its stream, so it evaluates the ones
+     *        Network::train would evaluate after Randomizer::setStream with the same stream.
+     *
+     * @param trainingSet - The training set.
+     * @param testSet - The test set.
+     * @param trainEsts - The Estimator for the training set of each candidate.
+     * @param testEsts - The Estimator for the test set of each candidate.
+     * @param hyperPars - The hyperparameters of each candidate.
+     * @param streams - The stream of each candidate (none = all of them draw in turn from the current one).
+     */
+    void NetworkBatch::train(const dataSet &trainingSet, const dataSet &testSet, const vector<Estimator*> &trainEsts,
+                                const vector<Estimator*> &testEsts, const vector<parameters> &hyperPars,
+                                const vector<uint64_t> &streams){
+        const size_t K = this->candidates;
+
+        if(trainEsts.size() != K || testEsts.size() != K || hyperPars.size() != K)
+            throw invalid_argument("Each candidate needs its estimators and its hyperparameters.");
+        if(!streams.empty() && streams.size() != K)
+            throw invalid_argument("Each candidate needs its stream.");
+        if(trainingSet.inputs.size() != trainingSet.results.size() ||
+            (trainingSet.isSparse() && trainingSet.active.size() != trainingSet.results.size()))
+            throw invalid_argument("The size of training set patterns and of the expected results do not match.");
+
+        const parameters &shared = hyperPars[0];
+        for(const parameters &pars : hyperPars)
+            if(pars.mb != shared.mb || pars.eval_step != shared.eval_step || pars.eval_size != shared.eval_size ||
+                pars.keep_best != shared.keep_best || pars.shuffle != shared.shuffle ||
+                pars.shuffle_seed != shared.shuffle_seed)
+                throw invalid_argument("The candidates of a batch must share the mini-batch size and the evaluation "
+                                        "and shuffling parameters.");
+
+        vector<parameters> currPars = hyperPars;
+        vector<size_t> order(trainingSet.inputs.size());
+        // The patterns of the test set evaluated by each candidate and the union of them, all in ascending order.
+        vector<vector<size_t>> candidatePatt(K);
+        vector<size_t> testPatt;
+        for(size_t k = 0; k < K; ++k){
+            if(!streams.empty())    math::Randomizer::setStream(streams[k]);
+            candidatePatt[k] = Network::evaluationSubset(testSet.inputs.size(), shared.eval_size);
+            vector<size_t> merged;
+            set_union(testPatt.begin(), testPatt.end(), candidatePatt[k].begin(), candidatePatt[k].end(),
+                        back_inserter(merged));
+            testPatt = move(merged);
+        }
+        vector<size_t> next(K);
+        size_t mb_size = max<size_t>(1, shared.mb <= order.size() ? shared.mb : order.size());
+        const size_t outputs = this->layers.back().neurons;
+        vector<bool> running(K, true), evaluate(K, false), hasBest(K, false);
+        vector<size_t> done(K, 0), bestEpoch(K, 0);
+        vector<vector<double>> evaluated(this->layers.size()), best(this->layers.size());
+        iota(order.begin(), order.end(), 0);
+
+        if(shared.keep_best)
+            for(size_t l = 0; l < this->layers.size(); ++l)
+                best[l].resize(this->layers[l].weights.size());
+
+        for(size_t epoch = 0; ; ++epoch){
+            bool anyRunning = false, anyEvaluate = false;
+
+            for(size_t k = 0; k < K; ++k){
+                running[k] = running[k] && epoch < currPars[k].max_epoch && !trainEsts[k]->stoppingCriteria();
+                if(running[k])  done[k] = epoch + 1;
+                // Evaluate the test set only if the estimator is going to use it.
+                evaluate[k] = running[k] && shared.eval_step > 0 && epoch % shared.eval_step == 0 &&
+                                testEsts[k]->toEvaluate(epoch);
+
+                if(running[k] && currPars[k].checkpoint && binary_search(currPars[k].checkpoints.begin(),
+                                                                currPars[k].checkpoints.end(), epoch)){
+                    // The net that a training with max_epoch = epoch would return (see Network::train).
+                    vector<const vector<double>*> stacked;
+                    for(size_t l = 0; l < this->layers.size(); ++l)
+                        stacked.push_back(hasBest[k] ? &best[l] : &this->layers[l].weights);
+                    Network net = this->unstack(stacked, k);
+                    net.setTrained(hasBest[k] ? bestEpoch[k] : epoch, hasBest[k]);
+                    currPars[k].checkpoint(net, epoch);
+                }
+
+                if(running[k]){
+                    trainEsts[k]->init(epoch);
+                    if(evaluate[k]) testEsts[k]->init(epoch);
+                    currPars[k].update(currPars[k], epoch); // Update the hyper-parameter.
+                }
+
+                // A stopped candidate has null hyperparameters, so its weights do not change anymore.
+                this->eta[k] = running[k] ? currPars[k].eta : 0;
+                this->mi[k] = running[k] ? currPars[k].mi : 0;
+                this->lambda[k] = running[k] ? currPars[k].lambda : 0;
+                anyRunning = anyRunning || running[k];
+                anyEvaluate = anyEvaluate || evaluate[k];
+            }
+
+            if(!anyRunning) break;
+
+            // Compute test errors and accuracy with the weights at the start of the epoch.
+            if(anyEvaluate){
+                if(shared.keep_best)
+                    for(size_t l = 0; l < this->layers.size(); ++l)
+                        evaluated[l] = this->layers[l].weights;
+
+                fill(next.begin(), next.end(), 0);
+                for(size_t j = 0; j < testPatt.size(); ++j){
+                    bool picked = false;
+                    for(size_t k = 0; k < K; ++k)
+                        picked = picked || (evaluate[k] && next[k] < candidatePatt[k].size() && 
+                                            candidatePatt[k][next[k]] == testPatt[j]);
+                    if(picked){
+                        this->loadInput(testSet, testPatt[j]);
+                        this->feed_forward();
+                    }
+
+                    for(size_t k = 0; k < K; ++k){
+                        if(next[k] == candidatePatt[k].size() || candidatePatt[k][next[k]] != testPatt[j]) continue;
+                        if(evaluate[k]) testEsts[k]->update(this->getOutput(k), testSet.results[testPatt[j]]);
+                        ++next[k];
+                    }
+                }
+            }
+
+            if(shared.shuffle)  Network::shuffleOrder(order, shared.shuffle_seed, epoch);
+
+            for(size_t i = 0; i < order.size() / mb_size; ++i){
+                auto end = i == order.size() / mb_size - 1 ? order.size() : ((i + 1) * mb_size);
+
+                // Compute the back propagation step for a group of patterns.
+                for(size_t j = i * mb_size; j < end; ++j){
+                    const vector<double> &expected = trainingSet.results[order[j]];
+                    if(expected.size() != outputs)
+                        throw invalid_argument("The results size does not match the expected one.");
+
+                    this->loadInput(trainingSet, order[j]);
+                    this->feed_forward();
+
+                    // The stopped candidates have no errors.
+                    this->errors.assign(outputs * K, 0);
+                    for(size_t k = 0; k < K; ++k){
+                        if(!running[k]) continue;
+
+                        vector<double> out = this->getOutput(k);
+                        trainEsts[k]->update(out, expected);
+                        vector<double> err = (*this->model.errorFunc)(expected, out);
+                        for(size_t o = 0; o < outputs; ++o)
+                            this->errors[o * K + k] = err[o];
+                    }
+
+                    this->back_propagation();
+                }
+
+                this->updateWeights(shared.mb);
+            }
+
+            for(size_t k = 0; k < K; ++k){
+                if(!running[k]) continue;
+
+                trainEsts[k]->plot();
+                if(evaluate[k]) testEsts[k]->plot();
+
+                // Keep the evaluated weights if they are the best ones.
+                if(evaluate[k] && shared.keep_best && testEsts[k]->isBest()){
+                    for(size_t l = 0; l < this->layers.size(); ++l)
+                        copyCandidate(evaluated[l], best[l], k, K);
+                    hasBest[k] = true;
+                    bestEpoch[k] = epoch;
+                }
+            }
+        }
+
+        for(size_t k = 0; k < K; ++k){
+            if(hasBest[k])
+                for(size_t l = 0; l < this->layers.size(); ++l)
+                    copyCandidate(best[l], this->layers[l].weights, k, K);
+            this->trained[k] = hasBest[k] ? bestEpoch[k] : done[k];
+            this->restored[k] = hasBest[k];
+            trainEsts[k]->terminate(); testEsts[k]->terminate();
+        }
+    }
+}
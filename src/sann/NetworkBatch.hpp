@@ -0,0 +1,82 @@
+/*******************************************************
+ *                                                     *
+ *  sann: Neural Network library                       *
+ *                                                     *
+ *  NETWORK BATCH CLASS HEADER                         *
+ *                                                     *
+ *  Giulio Auriemma                                    *
+ *                                                     *
+ *******************************************************/
+
+#ifndef S_NETWORK_BATCH_S
+#define S_NETWORK_BATCH_S
+
+// System libraries include.
+#include <vector>
+#include <cstdint>
+
+// My includes.
+#include "dataStructures.h"
+#include "Network.hpp"
+#include "Estimator.hpp"
+#include "math/Func.hpp"
+
+namespace sann{
+
+/// This class trains K networks with the same topology at the same time, e.g. the candidates of a grid search. The
+/// weights of each layer are stacked in a single array laid out as [neuron][input][candidate], so every step of
+/// the forward and backward passes is a loop over the candidates with unit stride: small nets that cannot fill
+/// the SIMD lanes alone fill them together. Each candidate has its own hyperparameters and estimators, and the
+/// training of each one is the same of Network::train (with the same results). A stopped candidate keeps its
+/// weights while the others go on. The activation and error functions are the ones of the first net.
+class NetworkBatch{
+private:
+    // STRUCT
+
+    struct stackedLayer{
+        std::size_t neurons, inputs;    // The inputs do not count the bias.
+        math::Func func;
+        std::vector<double> weights, currErrors, prevErrors;    // [neuron][input + bias][candidate]
+        std::vector<double> nets, outs, deltas;                 // [neuron][candidate]
+    };
+
+    // ATTRIBUTES
+
+    Network model;  // The first net, used to give back the trained ones.
+    std::vector<stackedLayer> layers;
+    std::size_t candidates;
+    std::vector<double> input, errors, prevErrors; // [input][candidate]
+    std::vector<double> eta, mi, lambda;    // The hyperparameters of each candidate, 0 for the stopped ones.
+    std::vector<std::size_t> trained;       // The epochs trained by the weights of each candidate.
+    std::vector<bool> restored;             // True for the candidates that have their best weights.
+
+    // METHODS
+
+    void loadInput(const sann::dataSet &set, const std::size_t i);
+    void feed_forward();
+    std::vector<double> getOutput(const std::size_t k) const;
+    Network unstack(const std::vector<const std::vector<double>*> &stacked, const std::size_t k) const;
+    void back_propagation();
+    void updateWeights(const std::size_t mb);
+
+public:
+    // CONSTRUCTORS
+
+    NetworkBatch(const std::vector<Network> &nets);
+
+    // METHODS
+
+    std::size_t size() const;
+    Network getNetwork(const std::size_t k) const;
+
+    // COMPUTATION
+
+    std::vector<double> compute(const sann::dataSet &set, const std::size_t i, const std::size_t k);
+    void train(const sann::dataSet &trainingSet, const sann::dataSet &testSet,
+                const std::vector<sann::Estimator*> &trainEsts, const std::vector<sann::Estimator*> &testEsts,
+                const std::vector<sann::parameters> &hyperPars, const std::vector<std::uint64_t> &streams = {});
+};
+
+}
+
+#endif
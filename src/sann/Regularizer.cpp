@@ -14,6 +14,8 @@
 #include <climits>
 #include <numeric>
 #include <cmath>
+#include <algorithm>
+#include <limits>
 
 using namespace std;
 
@@ -27,6 +29,23 @@ namespace sann{
         return ret;
     }
 
+    /**
+     * @brief Finds the minimum and the maximum value of each attribute of a set of vectors.
+     * 
+     * @param vectors - The vectors.
+     * @param minima - The minimum of each attribute.
+     * @param maxima - The maximum of each attribute.
+     */
+    void findBounds(const vector<vector<double>> &vectors, vector<short> &minima, vector<short> &maxima){
+        maxima.assign(vectors[0].size(), SHRT_MIN); minima.assign(vectors[0].size(), SHRT_MAX);
+        for(const auto &vec : vectors){
+            for(size_t i = 0; i < vec.size(); i++){
+                if(maxima[i] < vec[i])    maxima[i] = vec[i];
+                if(minima[i] > vec[i])    minima[i] = vec[i];
+            }
+        }
+    }
+
 
     /**
      * @brief Returns a data set with the 1-of-k representations of the data on the starting data set.
@@ -39,16 +58,12 @@ namespace sann{
             vector<vector<double>> classVector;
 
             // Find maxima and minima for inputs sets.
-            vector<short> maxima(vectors[0].size(), SHRT_MIN), minima(vectors[0].size(), SHRT_MAX);
-            for(auto vec : vectors){
-                for(size_t i = 0; i < vec.size(); i++){
-                    if(maxima[i] < vec[i])    maxima[i] = vec[i];
-                    if(minima[i] > vec[i])    minima[i] = vec[i];
-                }
-            }
+            vector<short> maxima, minima;
+            findBounds(vectors, minima, maxima);
 
             // Assign to new data set the regularized input.
-            for(auto vec : vectors)
+            classVector.reserve(vectors.size());
+            for(const auto &vec : vectors)
                 classVector.push_back(Regularizer::getOneOfKVector(vec, minima, maxima));
 
             return classVector;
@@ -68,6 +83,49 @@ namespace sann{
         return newDataSet;
     }
 
+    /**
+     * @brief Returns a data set with the sparse 1-of-k representations of the data on the starting data set: each
+     *        pattern only holds the indexes of its inputs equal to 1, one for each attribute. The indexes are the
+     *        same of the dense representation given by getOneOfKDataSet, so the same net can be used on both.
+     * 
+     * @param dataSet - The starting data set.
+     * @return dataSet - The sparse data set with 1-of-k representations.
+     */
+    dataSet Regularizer::getSparseOneOfKDataSet(const dataSet &dataSet){
+        sann::dataSet newDataSet;
+        vector<short> maxima, minima;
+        findBounds(dataSet.inputs, minima, maxima);
+
+        newDataSet.inputs.resize(dataSet.inputs.size());
+        newDataSet.active.resize(dataSet.inputs.size());
+        #pragma omp parallel for
+        for(size_t i = 0; i < dataSet.inputs.size(); ++i)
+            newDataSet.active[i] = Regularizer::getOneOfKIndexes(dataSet.inputs[i], minima, maxima);
+
+        newDataSet.results = app(dataSet.results);
+        newDataSet.names = dataSet.names;
+
+        return newDataSet;
+    }
+
+    /**
+     * @brief Returns the number of categories of each attribute of a data set, i.e. the size of its 1-of-k
+     *        representation. It is the one expected by an Embedding of the sparse data set.
+     * 
+     * @param dataSet - The data set.
+     * @return vector<size_t> - The number of categories of each attribute.
+     */
+    vector<size_t> Regularizer::getCategories(const dataSet &dataSet){
+        vector<short> maxima, minima;
+        findBounds(dataSet.inputs, minima, maxima);
+
+        vector<size_t> categories(maxima.size());
+        for(size_t i = 0; i < maxima.size(); ++i)
+            categories[i] = maxima[i] - minima[i] + 1;
+
+        return categories;
+    }
+
     /**
      * @brief Returns the vector with the 1-of-k representation of the starting vector.
      * 
@@ -90,4 +148,253 @@ namespace sann{
         return ret;
     }
 
+
+    /**
+     * @brief Returns the indexes of the elements equal to 1 in the 1-of-k representation of the starting vector.
+     *        A value out of its bounds has no active element, as in getOneOfKVector.
+     * 
+     * @param vec - The starting vector.
+     * @param min - The min value for every element of the vector.
+     * @param max - The max value for every element of the vector.
+     * @return vector<size_t> - The increasing indexes of the active elements.
+     */
+    vector<size_t> Regularizer::getOneOfKIndexes(const vector<double> &vec, const vector<short> &min, const vector<short> &max){
+        if(vec.size() != max.size() || vec.size() != min.size())
+            throw invalid_argument("The sizes of the vector, maxes and mins do not match.");
+        
+        vector<size_t> ret;
+        ret.reserve(vec.size());
+        
+        for(size_t i = 0, offset = 0; i < vec.size(); offset += max[i] - min[i] + 1, i++)
+            for(short j = min[i]; j <= max[i]; j++)
+                if(j == vec[i]){
+                    ret.push_back(offset + j - min[i]);
+                    break;
+                }
+
+        return ret;
+    }
+
+
+    // PIPELINE
+
+    /**
+     * @brief Creates a pipeline not fitted yet.
+     * 
+     * @param inputs - The scaling of each input column. If it has only one element, it is used for all the columns.
+     * @param results - The scaling of all the result columns (NONE by default). ONE_OF_K is not allowed.
+     */
+    Regularizer::Pipeline::Pipeline(const vector<Regularizer::Pipeline::scaling> &inputs, 
+                                        const Regularizer::Pipeline::scaling results) : 
+        inputTypes(inputs), resultType(results){
+        if(inputs.empty())
+            throw invalid_argument("The scaling of the inputs is missing.");
+        if(results == ONE_OF_K)
+            throw invalid_argument("The results cannot be expanded in 1-of-k.");
+    }
+
+    /**
+     * @brief Computes the transformation of each column. The minimum, the maximum, the mean and the variance of
+     *        all the columns are computed in a single parallel pass: every thread works on its own rows (Welford)
+     *        and then the partial statistics are merged.
+     * 
+     * @param vectors - The rows on which fit the transformation.
+     * @param types - The scaling of each column, or of all the columns if it has only one element.
+     * @param width - Returns the size of the transformed rows.
+     * @return vector<column> - The transformation of each column.
+     */
+    vector<Regularizer::Pipeline::column> Regularizer::Pipeline::fitColumns(const vector<vector<double>> &vectors, 
+                                                    const vector<scaling> &types, size_t &width){
+        if(vectors.empty() || vectors[0].empty())
+            throw invalid_argument("The pipeline cannot be fitted on an empty set.");
+
+        const size_t n = vectors[0].size();
+        if(types.size() != 1 && types.size() != n)
+            throw invalid_argument("The number of scalings does not match the number of columns.");
+        if(any_of(vectors.begin(), vectors.end(), [n](const vector<double> &row){ return row.size() != n; }))
+            throw invalid_argument("The rows of the set have different sizes.");
+
+        vector<double> minima(n, numeric_limits<double>::max()), maxima(n, numeric_limits<double>::lowest()),
+                        mean(n, 0), m2(n, 0);
+        size_t count = 0;
+
+        #pragma omp parallel
+        {
+        vector<double> tMin(n, numeric_limits<double>::max()), tMax(n, numeric_limits<double>::lowest()), 
+                        tMean(n, 0), tM2(n, 0);
+        size_t tCount = 0;
+
+        #pragma omp for nowait
+        for(size_t r = 0; r < vectors.size(); ++r){
+            const vector<double> &row = vectors[r];
+
+            ++tCount;
+            for(size_t i = 0; i < n; ++i){
+                double delta = row[i] - tMean[i];
+                tMean[i] += delta / tCount;
+                tM2[i] += delta * (row[i] - tMean[i]);
+                tMin[i] = min(tMin[i], row[i]);
+                tMax[i] = max(tMax[i], row[i]);
+            }
+        }
+
+        #pragma omp critical(pipelineFit)
+        if(tCount > 0){
+            size_t total = count + tCount;
+            for(size_t i = 0; i < n; ++i){
+                double delta = tMean[i] - mean[i];
+                m2[i] += tM2[i] + delta * delta * count * tCount / total;
+                mean[i] += delta * tCount / total;
+                minima[i] = min(minima[i], tMin[i]);
+                maxima[i] = max(maxima[i], tMax[i]);
+            }
+            count = total;
+        }
+        }
+
+        vector<column> cols(n);
+        width = 0;
+        for(size_t i = 0; i < n; ++i){
+            column &col = cols[i];
+            double range = maxima[i] - minima[i], stddev = sqrt(m2[i] / count);
+
+            col.type = types.size() == 1 ? types[0] : types[i];
+            col.offset = width;
+            col.width = col.type == ONE_OF_K ? (size_t)(range + 1) : 1;
+            col.shift = col.type == Z_SCORE ? mean[i] : (col.type == NONE ? 0 : minima[i]);
+            col.scale = col.type == MIN_MAX ? (range > 0 ? 1 / range : 1) : 
+                        (col.type == Z_SCORE ? (stddev > 0 ? 1 / stddev : 1) : 1);
+            width += col.width;
+        }
+
+        return cols;
+    }
+
+    /**
+     * @brief Applies the transformation to a row, whose size must be already checked.
+     * 
+     * @param cols - The transformation of each column.
+     * @param in - The row.
+     * @param out - The transformed row, already zeroed.
+     */
+    void Regularizer::Pipeline::transform(const vector<column> &cols, const vector<double> &in, double *out){
+        for(size_t i = 0; i < cols.size(); ++i){
+            const column &col = cols[i];
+
+            if(col.type == ONE_OF_K){
+                // A category never seen during the fit has no active element.
+                double k = in[i] - col.shift;
+                if(k >= 0 && k < col.width)  out[col.offset + (size_t)k] = 1;
+            }
+            else
+                out[col.offset] = (in[i] - col.shift) * col.scale;
+        }
+    }
+
+    /**
+     * @brief Computes the statistics of the data set needed by the transformations.
+     * 
+     * @param dataSet - The data set on which fit the pipeline.
+     */
+    void Regularizer::Pipeline::fit(const dataSet &dataSet){
+        size_t resultWidth;
+
+        this->inputCols = fitColumns(dataSet.inputs, this->inputTypes, this->inputWidth);
+        this->resultCols = fitColumns(dataSet.results, {this->resultType}, resultWidth);
+        this->fitted = true;
+    }
+
+    /**
+     * @brief Returns a new data set with the transformed inputs and results. All the rows are transformed in a
+     *        single parallel pass.
+     * 
+     * @param dataSet - The data set to transform.
+     * @return dataSet - The transformed data set.
+     */
+    dataSet Regularizer::Pipeline::apply(const dataSet &dataSet) const{
+        if(!this->fitted)
+            throw logic_error("The pipeline has not been fitted.");
+        if(dataSet.inputs.size() != dataSet.results.size())
+            throw invalid_argument("The size of the patterns and of the expected results do not match.");
+        for(size_t r = 0; r < dataSet.inputs.size(); ++r)
+            if(dataSet.inputs[r].size() != this->inputCols.size() || dataSet.results[r].size() != this->resultCols.size())
+                throw invalid_argument("The size of the pattern " + to_string(r) + " does not match the fitted one.");
+
+        sann::dataSet newDataSet;
+        newDataSet.names = dataSet.names;
+        newDataSet.inputs.resize(dataSet.inputs.size());
+        newDataSet.results.resize(dataSet.results.size());
+
+        #pragma omp parallel for
+        for(size_t r = 0; r < dataSet.inputs.size(); ++r){
+            newDataSet.inputs[r].assign(this->inputWidth, 0);
+            newDataSet.results[r].assign(this->resultCols.size(), 0);
+            transform(this->inputCols, dataSet.inputs[r], newDataSet.inputs[r].data());
+            transform(this->resultCols, dataSet.results[r], newDataSet.results[r].data());
+        }
+
+        return newDataSet;
+    }
+
+    /**
+     * @brief Transforms the inputs of a single pattern, e.g. before computing it with a trained net.
+     * 
+     * @param inputs - The inputs.
+     * @return vector<double> - The transformed inputs.
+     */
+    vector<double> Regularizer::Pipeline::applyInputs(const vector<double> &inputs) const{
+        if(!this->fitted)
+            throw logic_error("The pipeline has not been fitted.");
+        if(inputs.size() != this->inputCols.size())
+            throw invalid_argument("The size of the inputs does not match the fitted one.");
+
+        vector<double> out(this->inputWidth);
+        transform(this->inputCols, inputs, out.data());
+        return out;
+    }
+
+    /**
+     * @brief Transforms the expected results of a single pattern.
+     * 
+     * @param results - The expected results.
+     * @return vector<double> - The transformed results.
+     */
+    vector<double> Regularizer::Pipeline::applyResults(const vector<double> &results) const{
+        if(!this->fitted)
+            throw logic_error("The pipeline has not been fitted.");
+        if(results.size() != this->resultCols.size())
+            throw invalid_argument("The size of the results does not match the fitted one.");
+
+        vector<double> out(this->resultCols.size());
+        transform(this->resultCols, results, out.data());
+        return out;
+    }
+
+    /**
+     * @brief Brings the outputs of a net trained on transformed results back to the original scale.
+     * 
+     * @param outputs - The outputs of the net.
+     * @return vector<double> - The outputs in the original scale.
+     */
+    vector<double> Regularizer::Pipeline::revertResults(const vector<double> &outputs) const{
+        if(!this->fitted)
+            throw logic_error("The pipeline has not been fitted.");
+        if(outputs.size() != this->resultCols.size())
+            throw invalid_argument("The size of the outputs does not match the fitted one.");
+
+        vector<double> out(outputs.size());
+        for(size_t i = 0; i < outputs.size(); ++i)
+            out[i] = outputs[i] / this->resultCols[i].scale + this->resultCols[i].shift;
+        return out;
+    }
+
+    /**
+     * @brief Returns the size of the transformed inputs, i.e. the input size of the net.
+     * 
+     * @return size_t - The size of the transformed inputs.
+     */
+    size_t Regularizer::Pipeline::getInputSize() const{
+        return this->inputWidth;
+    }
+
 }
\ No newline at end of file
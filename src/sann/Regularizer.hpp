@@ -18,8 +18,61 @@ namespace sann{
 /// This is the class for the regularization of the data.
 class Regularizer{
 public:
+    // CLASSES
+
+    /// A fitted preprocessing of the data: the statistics of each column are computed once on a data set (usually
+    /// the training one) and then the same transformation can be applied to any other set or single pattern.
+    class Pipeline{
+    public:
+        enum scaling{NONE, MIN_MAX, Z_SCORE, ONE_OF_K};
+
+    private:
+        // STRUCT
+
+        /// The transformation of a column, out = (in - shift) * scale, or the k-th element for ONE_OF_K.
+        struct column{
+            scaling type;
+            double shift, scale;
+            std::size_t offset, width;
+        };
+
+        // ATTRIBUTES
+
+        std::vector<scaling> inputTypes;
+        scaling resultType;
+        std::vector<column> inputCols, resultCols;
+        std::size_t inputWidth = 0;
+        bool fitted = false;
+
+        // METHODS
+
+        static std::vector<column> fitColumns(const std::vector<std::vector<double>> &vectors, 
+                                                const std::vector<scaling> &types, std::size_t &width);
+        static void transform(const std::vector<column> &cols, const std::vector<double> &in, double *out);
+
+    public:
+        // CONSTRUCTORS
+
+        Pipeline(const std::vector<scaling> &inputs, const scaling results = NONE);
+
+        // METHODS
+
+        void fit(const dataSet &dataSet);
+        dataSet apply(const dataSet &dataSet) const;
+        std::vector<double> applyInputs(const std::vector<double> &inputs) const;
+        std::vector<double> applyResults(const std::vector<double> &results) const;
+        std::vector<double> revertResults(const std::vector<double> &outputs) const;
+        std::size_t getInputSize() const;
+    };
+
+    // METHODS
+
     static dataSet getOneOfKDataSet(const dataSet &dataSet);
+    static dataSet getSparseOneOfKDataSet(const dataSet &dataSet);
+    static std::vector<std::size_t> getCategories(const dataSet &dataSet);
     static std::vector<double> getOneOfKVector(const std::vector<double> &vec, const std::vector<short> &min, const std::vector<short> &max);
+    static std::vector<std::size_t> getOneOfKIndexes(const std::vector<double> &vec, const std::vector<short> &min, 
+                                                        const std::vector<short> &max);
 };
 
 }
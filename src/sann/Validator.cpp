@@ -11,10 +11,17 @@
 
 //Other system includes.
 #include <stdexcept>
+#include <fstream>
+#include <numeric>
+#include <cstdint>
 #include <math.h>
+#include <chrono>
+#include <mutex>
 
 // My include
+#include "NetworkBatch.hpp"
 #include "utility/Logger.hpp"
+#include "math/Randomizer.hpp"
 #include "utility/FileManager.hpp"
 
 #ifdef S_DEBUG_MODE_S
@@ -27,6 +34,128 @@ using namespace sann::math;
 namespace sann{
     size_t validationNum = 0; // To avoid name clashes on file creation.
 
+    namespace{
+        /**
+         * @brief Wraps the training estimator of a candidate to stop its training at the deadline of the search.
+         *        It remembers if the training has been stopped by the deadline and how many epochs it did.
+         * 
+         */
+        class DeadlineEstimator : public Estimator{
+        private:
+            Estimator &est;
+            const chrono::steady_clock::time_point deadline;
+            size_t epochs = 0;
+            bool stopped = false;
+        public:
+            DeadlineEstimator(Estimator &est, const chrono::steady_clock::time_point deadline) : est(est), 
+                deadline(deadline){}
+            void init(const size_t epoch){ this->epochs = epoch + 1; this->est.init(epoch); }
+            bool stoppingCriteria(){
+                if(this->est.stoppingCriteria())    return true;
+                this->stopped = chrono::steady_clock::now() >= this->deadline;
+                return this->stopped;
+            }
+            void update(const vector<double> &out, const vector<double> &expected){ this->est.update(out, expected); }
+            void plot(){ this->est.plot(); }
+            void terminate(){ this->est.terminate(); }
+            bool toEvaluate(const size_t epoch){ return this->est.toEvaluate(epoch); }
+            bool isBest(){ return this->est.isBest(); }
+            void profile(const size_t epoch, const utility::Profiler::timings &timings){ 
+                this->est.profile(epoch, timings); 
+            }
+            bool isStopped() const{ return this->stopped; }
+            size_t getEpochs() const{ return this->epochs; }
+        };
+    }
+
+    /**
+     * @brief Starts the budget of a search.
+     * 
+     * @param seconds - The seconds given to the search (0 = no deadline).
+     */
+    Validator::budgetState::budgetState(const double seconds) : start(chrono::steady_clock::now()), 
+        deadline(seconds > 0 ? start + chrono::duration_cast<chrono::steady_clock::duration>(
+                                        chrono::duration<double>(seconds)) 
+                             : chrono::steady_clock::time_point::max()) {}
+
+    /**
+     * @brief Waits until a training fits in the memory cap, together with the ones already running. A training
+     *        is always admitted when nothing else runs, even if it does not fit alone.
+     * 
+     * @param memory - The estimated memory of the training.
+     * @param cap - The memory cap (0 = no cap).
+     * @return bool - True if the training is admitted, false if the deadline has come first.
+     */
+    bool Validator::budgetState::admit(const size_t memory, const size_t cap){
+        unique_lock<mutex> guard(this->lock);
+        auto fits = [this, memory, cap](){ 
+            return cap == 0 || this->memory == 0 || this->held + this->memory + memory <= cap; 
+        };
+
+        if(this->deadline == chrono::steady_clock::time_point::max())   this->released.wait(guard, fits);
+        else                                                            this->released.wait_until(guard, this->deadline, fits);
+
+        if(!fits() || chrono::steady_clock::now() >= this->deadline){
+            this->report.expired = true;
+            return false;
+        }
+
+        this->memory += memory;
+        this->report.peakMemory = max(this->report.peakMemory, this->held + this->memory);
+        return true;
+    }
+
+    /**
+     * @brief Gives back the memory of a finished training and wakes up the ones waiting for it.
+     * 
+     * @param memory - The estimated memory of the training.
+     */
+    void Validator::budgetState::release(const size_t memory){
+        {
+            lock_guard<mutex> guard(this->lock);
+            this->memory -= memory;
+        }
+        this->released.notify_all();
+    }
+
+    /**
+     * @brief Holds the memory of a data set copied by the search until it is dropped. It is not a training, so it
+     *        never waits, but the trainings are admitted only if they fit in the cap together with it.
+     * 
+     * @param memory - The estimated memory of the data set.
+     */
+    void Validator::budgetState::hold(const size_t memory){
+        lock_guard<mutex> guard(this->lock);
+        this->held += memory;
+        this->report.peakMemory = max(this->report.peakMemory, this->held + this->memory);
+    }
+
+    /**
+     * @brief Gives back the memory of a copied data set and wakes up the trainings waiting for it.
+     * 
+     * @param memory - The estimated memory of the data set.
+     */
+    void Validator::budgetState::drop(const size_t memory){
+        {
+            lock_guard<mutex> guard(this->lock);
+            this->held -= memory;
+        }
+        this->released.notify_all();
+    }
+
+    /**
+     * @brief Adds a combination not trained until its epochs to the report.
+     * 
+     * @param parameters - The net and the hyperparameters of the combination.
+     * @param epochs - The epochs of the combination.
+     * @param trained - The epochs trained before the deadline.
+     */
+    void Validator::budgetState::addUnfinished(const string &parameters, const size_t epochs, const size_t trained){
+        lock_guard<mutex> guard(this->lock);
+        this->report.expired = true;
+        this->report.unfinished.push_back({parameters, epochs, trained});
+    }
+
     /**
      * @brief Creates a new Validator.
      * 
@@ -40,6 +169,43 @@ namespace sann{
         const shared_ptr<VdValidEstimator> validationEst) : loss(loss), trainingEst(trainingEst), 
         validationEst(validationEst) {}
 
+    /**
+     * @brief Writes the first size records on a file. The csv format has a row for each epoch with epoch, error
+     *        and accuracy. The binary one has the number of records (uint64) followed by the three values of each
+     *        record, all stored as doubles.
+     * 
+     * @param fileName - The name of the file.
+     * @param records - The records to write.
+     * @param size - The number of records to write.
+     * @param binary - True to write in binary format.
+     */
+    void Validator::writeRecords(const string &fileName, const vector<record> &records, const size_t size, 
+        const bool binary){
+        if(size > records.size())
+            throw invalid_argument("There are not enough records to write.");
+
+        if(binary){
+            uint64_t num = size;
+            vector<double> values;
+            values.reserve(size * 3);
+            for(size_t i = 0; i < size; ++i)
+                values.insert(values.end(), {(double)records[i].epoch, records[i].error, records[i].accuracy});
+
+            ofstream file(fileName, ios::out | ios::trunc | ios::binary);
+            file.write(reinterpret_cast<const char*>(&num), sizeof(num));
+            file.write(reinterpret_cast<const char*>(values.data()), sizeof(double) * values.size());
+            return;
+        }
+
+        string content;
+        content.reserve(size * 24);
+        for(size_t i = 0; i < size; ++i)
+            content += to_string(records[i].epoch) + ',' + to_string(records[i].error) + ',' + 
+                        to_string(records[i].accuracy) + '\n';
+
+        utility::FileManager::writeFile(fileName, content);
+    }
+
     /**
      * @brief Returns a new validator with the same attribute of the old one.
      * 
@@ -47,7 +213,9 @@ namespace sann{
      */
     Validator::Validator(const Validator &val) : loss(val.loss), epochs({val.epochs}), taus({val.taus}),
         alphas({val.alphas}), lambdas({val.lambdas}), etas({val.etas}), nets({val.nets}),
-        trainingEst(val.trainingEst), validationEst(val.validationEst){}
+        validationSize(val.validationSize), batchSize(val.batchSize), finalMode(val.finalMode), 
+        timeBudget(val.timeBudget), memoryBudget(val.memoryBudget), trainingEst(val.trainingEst), 
+        validationEst(val.validationEst){}
 
     /**
      * @brief Computes the expected risk approximating it to the empirical risk.
@@ -60,7 +228,7 @@ namespace sann{
         double risk = 0;
 
         for(size_t i = 0; i < vs.inputs.size(); i++){ 
-            vector<double> res = net.compute(vs.inputs[i]);
+            vector<double> res = net.compute(vs, i);
             risk += this->loss(res, vs.results[i]);
         }
 
@@ -126,15 +294,111 @@ namespace sann{
     }
 
     /**
-     * @brief Create the name of the file in which store validation result. If the folder containing the file
-     *        does not exist, create it.
+     * @brief Set the number of patterns of the validation set used to check the early stop criteria during
+     *        the grid search. The patterns are randomly chosen once for each trajectory, also when it is trained
+     *        in a batch (see setBatchedSearch). The risk of each model is always computed on the whole validation
+     *        set.
+     * 
+     * @param n - The number of patterns (0 = the whole validation set).
+     */
+    void Validator::setValidationSize(const size_t n){
+        this->validationSize = n;
+    }
+
+    /**
+     * @brief Sets the number of combinations of hyperparameters trained together by the grid search (see
+     *        NetworkBatch). The candidates are trained as they would be alone, each one on the patterns of the
+     *        validation set it would pick alone (see setValidationSize), but small nets run much faster. The nets
+     *        with an embedding cannot be batched, so their candidates are trained one after the other.
+     * 
+     * @param k - The number of combinations in each batch (1 = every combination trains its own net).
+     */
+    void Validator::setBatchedSearch(const size_t k){
+        this->batchSize = k > 0 ? k : 1;
+    }
+
+    /**
+     * @brief Sets how the selected model is trained at the end of the model selection (RETRAIN by default). When
+     *        the candidates are not retrained from scratch, they keep the weights with the best validation error.
+     * 
+     * @param mode - The final training mode.
+     */
+    void Validator::setFinalTraining(const Validator::finalTraining mode){
+        this->finalMode = mode;
+    }
+
+    /**
+     * @brief Sets a budget for the model selection. The trainings of the grid search start only while their
+     *        estimated memory (see estimateMemory) fits in the cap together with the running ones and with the
+     *        data sets copied by the search (e.g. the folds of the cross validation), so the cap also limits the
+     *        threads at work. When the deadline comes the running trainings are stopped and the others are not
+     *        started: the best model found so far is selected and returned as it is (as with CANDIDATE),
+     *        and the unfinished combinations are listed in the report (see getBudgetReport). The deadline only
+     *        bounds the search, the final training of RETRAIN and WARM_START comes after it.
+     * 
+     * @param seconds - The seconds given to each model selection (0 = no deadline).
+     * @param memory - The bytes given to the trainings run at the same time (0 = no cap).
+     */
+    void Validator::setBudget(const double seconds, const size_t memory){
+        this->timeBudget = seconds;
+        this->memoryBudget = memory;
+    }
+
+    /**
+     * @brief Returns the report of the last model selection. It is a copy, since a model selection run by another
+     *        thread may replace it.
+     * 
+     * @return Validator::budgetReport - The report.
+     */
+    Validator::budgetReport Validator::getBudgetReport() const{
+        lock_guard<mutex> guard(this->reportLock);
+        return this->report;
+    }
+
+    /**
+     * @brief Feeds an estimator with the outputs of a trained net, as if it were a training of one epoch. It is
+     *        used when the selected model is not trained again.
+     * 
+     * @param net - The trained net.
+     * @param set - The data set.
+     * @param est - The estimator.
+     */
+    void Validator::assess(Network &net, const dataSet &set, Estimator &est) const{
+        est.init(0);
+        for(size_t i = 0; i < set.inputs.size(); ++i)
+            est.update(net.compute(set, i), set.results[i]);
+        est.plot();
+        est.terminate();
+    }
+
+    /**
+     * @brief Prepares the final training to start from the trained candidate: the net takes its weights and the
+     *        parameters are changed to do only the remaining epochs, continuing the learning rate decay from the
+     *        epoch of those weights (the best one with keep_best).
+     * 
+     * @param model - The selected model, its parameters are updated.
+     * @param net - The net to train.
+     */
+    void Validator::warmStart(pars_container &model, Network &net) const{
+        size_t done = model.trained;
+        auto update = model.pars.update;
+
+        net = move(model.model);
+        model.pars.max_epoch = model.pars.max_epoch > done ? model.pars.max_epoch - done : 1;
+        model.pars.keep_best = false;
+        model.pars.update = [update, done](parameters &pars, const size_t epoch){ update(pars, epoch + done); };
+    }
+
+    /**
+     * @brief Creates the name of a combination from the structure of the net and the hyperparameters.
      * 
      * @param net - The neural network.
      * @param hyperP - The hyperparameters.
      * @param etaDecay - The vector composed by tau, eta0 and etat.
-     * @return string - The name of the file.
+     * @return string - The name of the combination.
      */
-    string Validator::getValidatorName(sann::Network &net, const sann::parameters &hyperP, const vector<double> &etaDecay) const{
+    string Validator::getParametersName(const Network &net, const parameters &hyperP, 
+                                        const vector<double> &etaDecay) const{
         vector<size_t> sizes = net.getlayersSizes();
         auto no_trail = [](const double x){
             string str = to_string(x);
@@ -150,63 +414,320 @@ namespace sann{
         str += "- t:" + no_trail(etaDecay[0]) + ", e:" + no_trail(etaDecay[1]) + "|" + no_trail(etaDecay[2]) 
             + ", m:" + no_trail(hyperP.mi) + ", l:" + no_trail(hyperP.lambda);
 
+        return str;
+    }
+
+    /**
+     * @brief Create the name of the file in which store validation result. If the folder containing the file
+     *        does not exist, create it.
+     * 
+     * @param net - The neural network.
+     * @param hyperP - The hyperparameters.
+     * @param etaDecay - The vector composed by tau, eta0 and etat.
+     * @return string - The name of the file.
+     */
+    string Validator::getValidatorName(sann::Network &net, const sann::parameters &hyperP, const vector<double> &etaDecay) const{
+        string str = this->getParametersName(net, hyperP, etaDecay);
+
         #pragma omp critical(nameGiver)
         {
-            utility::FileManager::createFolder(FILES_DIR + "validation/" + str);
+            utility::FileManager::createFolder(utility::FileManager::getFilesDir() + "validation/" + str);
             str += "/" + to_string(validationNum++);
         }
         
         return str; 
     }
 
+    /**
+     * @brief Returns the parameters of a combination of the grid search. The combinations are numbered with the
+     *        lambdas varying first and the epochs last.
+     * 
+     * @param index - The index of the combination.
+     * @param trainingSize - The size of the training set, it is the size of the mini-batches.
+     * @return Validator::pars_container - The parameters, without results.
+     */
+    Validator::pars_container Validator::getCombination(const size_t index, const size_t trainingSize) const{
+        size_t rest = index;
+        const size_t il = rest % this->lambdas.size();  rest /= this->lambdas.size();
+        const size_t ia = rest % this->alphas.size();   rest /= this->alphas.size();
+        const size_t ie = rest % this->etas.size();     rest /= this->etas.size();
+        const size_t it = rest % this->taus.size();     rest /= this->taus.size();
+        const size_t ip = rest;
+
+        float tau = this->taus[it], eta0 = this->etas[ie][0], etat = this->etas[ie][1];
+        parameters hyperP = {this->epochs[ip], trainingSize, 0, this->alphas[ia], this->lambdas[il], 
+            [tau, eta0, etat](parameters &pars, const size_t epoch){
+                float alfa = min((double)epoch / tau, 1.);
+                pars.eta = (1. - alfa) * eta0 + alfa * etat;
+        }};
+        hyperP.eval_size = this->validationSize;
+        hyperP.keep_best = this->finalMode != Validator::RETRAIN;
+
+        pars_container model;
+        model.pars = hyperP;
+        model.tau = tau; model.eta0 = eta0; model.etat = etat;
+        return model;
+    }
+
+    /**
+     * @brief Returns true if the trained candidates are kept: they are needed when the selected one is not
+     *        retrained, or when a deadline could stop the search.
+     * 
+     * @return bool - True if the candidates are kept.
+     */
+    bool Validator::keepsCandidates() const{
+        return this->finalMode != Validator::RETRAIN || this->timeBudget > 0;
+    }
+
+    /**
+     * @brief Estimates the memory used by the training of a batch of trajectories of the grid search. Each
+     *        trajectory has the net of the search, its training copy (or its part of the stacked nets), the
+     *        snapshot of the checkpoints, the kept candidates and the best weights, plus the histories of the
+     *        estimators with the strings in which they are written and the indexes of the patterns. The stacked
+     *        nets of a batch also have their inputs, always dense (see NetworkBatch::loadInput), and the errors
+     *        on them. The table of an embedding is counted as the weights of the layers, with its rows and the
+     *        bookkeeping of each category. The data sets are not copied by the trainings (see estimateMemory for
+     *        a data set).
+     * 
+     * @param net - The net of the search.
+     * @param tr - The training set.
+     * @param vs - The validation set.
+     * @param trajectories - The number of trajectories trained together.
+     * @return size_t - The estimated bytes.
+     */
+    size_t Validator::estimateMemory(const Network &net, const dataSet &tr, const dataSet &vs, 
+                                        const size_t trajectories) const{
+        vector<size_t> sizes = net.getlayersSizes();
+        size_t weights = 0, neurons = 0;
+        for(size_t i = 1; i < sizes.size(); ++i){
+            weights += (sizes[i - 1] + 1) * sizes[i];
+            neurons += sizes[i];
+        }
+
+        // The table of the embedding has its errors and momentum too, each one stored as a row per category.
+        const Embedding &embedding = net.getEmbedding();
+        const size_t categories = embedding.getCategories();
+        weights += embedding.getWeightsNumber();
+
+        // The weights, their errors and the momentum, plus the values kept for each neuron.
+        const size_t netSize = sizeof(double) * (3 * weights + 4 * neurons) + 
+                                categories * (3 * sizeof(vector<double>) + sizeof(size_t) + 1),
+                        epochs = *max_element(this->epochs.begin(), this->epochs.end());
+        size_t trajectory = netSize * (3 + (this->keepsCandidates() ? this->epochs.size() : 0)) + 
+                            sizeof(double) * 2 * weights;
+        trajectory += 2 * epochs * (sizeof(record) + 32);
+        trajectory += sizeof(size_t) * (tr.inputs.size() + vs.inputs.size());
+        // Only the nets without an embedding are stacked (see gridSearch).
+        if(trajectories > 1 && embedding.empty())   trajectory += sizeof(double) * 3 * sizes[0];
+
+        return trajectories * trajectory;
+    }
+
+    /**
+     * @brief Estimates the memory of a copy of a data set, e.g. the folds of the cross validation or the union of
+     *        the training and validation sets of the final training.
+     * 
+     * @param set - The data set.
+     * @return size_t - The estimated bytes.
+     */
+    size_t Validator::estimateMemory(const dataSet &set) const{
+        size_t bytes = sizeof(dataSet);
+        for(size_t i = 0; i < set.inputs.size(); ++i)
+            bytes += sizeof(double) * set.inputs[i].size() + 3 * sizeof(vector<double>);
+        for(size_t i = 0; i < set.results.size(); ++i)
+            bytes += sizeof(double) * set.results[i].size();
+        for(size_t i = 0; i < set.active.size(); ++i)
+            bytes += sizeof(size_t) * set.active[i].size();
+        for(const string &name : set.names)
+            bytes += sizeof(string) + name.size();
+
+        return bytes;
+    }
+
+    /**
+     * @brief Sets the results of a trained candidate: its risk on the validation set and the values of its training
+     *        estimator. When the net has the best weights of its training, the values are the ones of the epoch
+     *        of those weights. The net is moved in the candidate if it is not retrained.
+     * 
+     * @param model - The candidate.
+     * @param net - The trained net.
+     * @param est - The training estimator.
+     * @param vs - The validation set.
+     */
+    void Validator::setResults(pars_container &model, Network &net, const TrValidEstimator &est, 
+                                const dataSet &vs) const{
+        model.valError = this->expectedRisk(net, vs);
+        model.trained = net.getTrainedEpochs();
+        if(net.hasRestoredBest()){
+            record kept = est.getRecord(net.getTrainedEpochs());
+            model.accuracy = kept.accuracy;
+            model.trainError = kept.error;
+            model.epochs = kept.epoch;
+        }
+        else{
+            model.accuracy = est.getAccuracy();
+            model.trainError = est.getError();
+            model.epochs = (size_t)est.getEpoch();
+        }
+        if(this->keepsCandidates())     model.model = move(net);
+    }
+
     /**
      * @brief Return the best hyperparameters found by searching on all the possible combination. The returned model
      *        has the maximum number of epochs set to the mean of the various training stopping epochs. This way it
-     *        can prevent going in overfitting exploiting the early stop of various training instance.
+     *        can prevent going in overfitting exploiting the early stop of various training instance. The
+     *        combinations that differ only in the epochs follow the same trajectory, so only the longest one is
+     *        trained and the others are taken from its checkpoints. The trajectories are trained in batches of 
+     *        batchSize nets (see setBatchedSearch), each one started only when it fits in the budget. The 
+     *        combinations stopped by the deadline take the weights they have, the ones not started are skipped.
      * 
      * @param net - The network on.
      * @param tr - The training set.
      * @param vs - The validation set.
+     * @param search - The index of the grid search among the ones of the model selection (see modelSearch).
+     * @param budget - The budget of the search.
      * @return Validator::model - The best hyperparameters found.
      */
-    Validator::pars_container Validator::gridSearch(Network &net, const dataSet &tr, const dataSet &vs) const{
+    Validator::pars_container Validator::gridSearch(Network &net, const dataSet &tr, const dataSet &vs, 
+                                                    const size_t search, budgetState &budget) const{
         pars_container bestModel;
-        unsigned long currEpochs = 0; // It is needed to do the mean between epochs.
+        unsigned long currEpochs = 0, trained = 0; // They are needed to do the mean between epochs.
+        const size_t trajectories = this->taus.size() * this->etas.size() * this->alphas.size() * this->lambdas.size(),
+                        combinations = this->epochs.size() * trajectories,
+                        batches = combinations == 0 ? 0 : (trajectories + this->batchSize - 1) / this->batchSize,
+                        longest = max_element(this->epochs.begin(), this->epochs.end()) - this->epochs.begin();
         
-        #pragma omp parallel for collapse(4)
-        for(size_t ip = 0; ip < this->epochs.size(); ++ip){
-        for(size_t it = 0; it < this->taus.size(); ++it){
-        for(size_t ie = 0; ie < this->etas.size(); ++ie){
-        for(size_t ia = 0; ia < this->alphas.size(); ++ia){
-        for(size_t il = 0; il < this->lambdas.size(); ++il){
-            // Create the net and train it using chosen hyperparameters.
-            float tau = this->taus[it], eta0 = this->etas[ie][0], etat = this->etas[ie][1];
-            parameters hyperP = {this->epochs[ip], tr.inputs.size(), 0, this->alphas[ia], this->lambdas[il], 
-                [tau, eta0, etat](parameters &pars, const size_t epoch){
-                    float alfa = min((double)epoch / tau, 1.);
-                    pars.eta = (1. - alfa) * eta0 + alfa * etat;
-            }};
-            Network searchNet{net}; 
-            auto trEst = this->trainingEst->clone(this->getValidatorName(net, hyperP, {tau, eta0, etat}));
-            auto vdEst = this->validationEst->clone(*trEst);
-
-            searchNet.train(tr, vs, *trEst, *vdEst, hyperP);
-
-            // Compute the risk and check if it is the lower one.
-            pars_container currModel{hyperP, this->expectedRisk(searchNet, vs), trEst->getAccuracy(), trEst->getError(),
-                                    tau, eta0, etat};
-            utility::Logger::writeLog(to_string(currModel.valError) + " | " + to_string(tau) + " | " +
-                to_string(eta0) + " | " + to_string(etat) + " | " + to_string(this->alphas[ia]) + " | " +
-                to_string(this->lambdas[il]), utility::Logger::type::NONE, false);
-
-            #pragma omp critical(updateMin)
-            {
-            currEpochs += trEst->getEpoch() + 1;
-            if(currModel < bestModel)   bestModel = currModel;  
+        #pragma omp parallel for schedule(dynamic)
+        for(size_t b = 0; b < batches; ++b){
+            const size_t first = b * this->batchSize, last = min(first + this->batchSize, trajectories),
+                            memory = this->estimateMemory(net, tr, vs, last - first);
+
+            if(!budget.admit(memory, this->memoryBudget)){
+                for(size_t t = first; t < last; ++t){
+                    for(size_t e = 0; e < this->epochs.size(); ++e){
+                        pars_container model = this->getCombination(e * trajectories + t, tr.inputs.size());
+                        budget.addUnfinished(this->getParametersName(net, model.pars, 
+                                                {model.tau, model.eta0, model.etat}), model.pars.max_epoch, 0);
+                    }
+                }
+                continue;
+            }
+
+            // The combinations of each trajectory, one for each value of the epochs.
+            vector<vector<pars_container>> models(last - first);
+            vector<vector<string>> names(last - first);
+            vector<vector<bool>> reached(last - first, vector<bool>(this->epochs.size(), false));
+            vector<unique_ptr<TrValidEstimator>> trEsts;
+            vector<unique_ptr<VdValidEstimator>> vdEsts;
+            vector<DeadlineEstimator> timedEsts;
+            vector<parameters> pars;
+            timedEsts.reserve(models.size());
+
+            for(size_t t = 0; t < models.size(); ++t){
+                for(size_t e = 0; e < this->epochs.size(); ++e){
+                    models[t].push_back(this->getCombination(e * trajectories + first + t, tr.inputs.size()));
+                    names[t].push_back(this->getValidatorName(net, models[t].back().pars, 
+                                        {models[t].back().tau, models[t].back().eta0, models[t].back().etat}));
+                }
+                trEsts.push_back(this->trainingEst->clone(names[t][longest]));
+                vdEsts.push_back(this->validationEst->clone(*trEsts.back()));
+                timedEsts.emplace_back(*trEsts.back(), budget.deadline);
+
+                // The shorter combinations are taken when the trajectory reaches their epochs.
+                parameters trajectory = models[t][longest].pars;
+                for(size_t epoch : this->epochs)
+                    if(epoch < trajectory.max_epoch)    trajectory.checkpoints.push_back(epoch);
+                sort(trajectory.checkpoints.begin(), trajectory.checkpoints.end());
+                trajectory.checkpoints.erase(unique(trajectory.checkpoints.begin(), trajectory.checkpoints.end()),
+                                                trajectory.checkpoints.end());
+
+                TrValidEstimator *trEst = trEsts.back().get();
+                VdValidEstimator *vdEst = vdEsts.back().get();
+                trajectory.checkpoint = [this, &models, &names, &reached, &vs, trEst, vdEst, t](Network &snapshot, 
+                                                                                                const size_t epoch){
+                    for(size_t e = 0; e < this->epochs.size(); ++e){
+                        if(this->epochs[e] != epoch)    continue;
+
+                        Network candidate{snapshot};
+                        this->setResults(models[t][e], candidate, *trEst, vs);
+                        trEst->writeHistory(names[t][e]); vdEst->writeHistory(names[t][e]);
+                        reached[t][e] = true;
+                    }
+                };
+                pars.push_back(move(trajectory));
+            }
+
+            // Every batch draws from its own stream, so the search is reproducible whatever thread runs it. The
+            // streams of different nets, initializations and folds are different too.
+            math::Randomizer::setStream(search * trajectories + first);
+
+            // Create the nets and train them using chosen hyperparameters.
+            vector<Network> searchNets(pars.size(), net);
+            if(pars.size() == 1)
+                searchNets[0].train(tr, vs, timedEsts[0], *vdEsts[0], pars[0]);
+            else if(!net.getEmbedding().empty()){
+                // The embeddings cannot be stacked, so each net is trained alone on the stream of its own batch.
+                for(size_t k = 0; k < pars.size(); ++k){
+                    math::Randomizer::setStream(search * trajectories + first + k);
+                    searchNets[k].train(tr, vs, timedEsts[k], *vdEsts[k], pars[k]);
+                }
             }
-        }}}}}
+            else{
+                vector<Estimator*> trPtrs, vdPtrs;
+                for(size_t k = 0; k < pars.size(); ++k){
+                    trPtrs.push_back(&timedEsts[k]);
+                    vdPtrs.push_back(vdEsts[k].get());
+                }
+
+                // Each candidate draws from the stream it would have in a batch of its own.
+                vector<uint64_t> streams(pars.size());
+                iota(streams.begin(), streams.end(), search * trajectories + first);
 
-        currEpochs /= this->epochs.size() * this->taus.size() * this->etas.size() * this->alphas.size() * this->lambdas.size();
+                NetworkBatch batch{searchNets};
+                batch.train(tr, vs, trPtrs, vdPtrs, pars, streams);
+                for(size_t k = 0; k < pars.size(); ++k)
+                    searchNets[k] = batch.getNetwork(k);
+            }
+            budget.release(memory);
+
+            for(size_t t = 0; t < models.size(); ++t){
+                // The combinations not reached by a trajectory stopped by the deadline are unfinished.
+                for(size_t e = 0; e < this->epochs.size(); ++e){
+                    if(timedEsts[t].isStopped() && !reached[t][e] && 
+                        timedEsts[t].getEpochs() < models[t][e].pars.max_epoch)
+                        budget.addUnfinished(this->getParametersName(net, models[t][e].pars, 
+                                                {models[t][e].tau, models[t][e].eta0, models[t][e].etat}), 
+                                                models[t][e].pars.max_epoch, timedEsts[t].getEpochs());
+                }
+
+                // The trajectory stopped before the epochs of the combinations not reached, so they end with it.
+                for(size_t e = 0; e < this->epochs.size(); ++e){
+                    if(e == longest || reached[t][e])   continue;
+
+                    Network candidate{searchNets[t]};
+                    this->setResults(models[t][e], candidate, *trEsts[t], vs);
+                    trEsts[t]->writeHistory(names[t][e]); vdEsts[t]->writeHistory(names[t][e]);
+                }
+                this->setResults(models[t][longest], searchNets[t], *trEsts[t], vs);
+
+                // Check if the risk is the lower one.
+                for(pars_container &currModel : models[t]){
+                    if(utility::Logger::isActive(utility::Logger::type::NONE))
+                        utility::Logger::writeLog(to_string(currModel.valError) + " | " + to_string(currModel.tau) + 
+                            " | " + to_string(currModel.eta0) + " | " + to_string(currModel.etat) + " | " + 
+                            to_string(currModel.pars.mi) + " | " + to_string(currModel.pars.lambda), 
+                            utility::Logger::type::NONE, false);
+
+                    #pragma omp critical(updateMin)
+                    {
+                    currEpochs += currModel.epochs + 1; trained++;
+                    if(currModel < bestModel)   bestModel = currModel;  
+                    }
+                }
+            }
+        }
+
+        if(trained > 0)     currEpochs /= trained;
         bestModel.pars.max_epoch = currEpochs;
         return bestModel;
     }
@@ -218,9 +739,12 @@ namespace sann{
      * @param tr - The training set.
      * @param vs - The validation set.
      * @param net - The net on which hase been found the best model. It is returned through reference. 
+     * @param fold - The fold of the cross validation (0 without it).
+     * @param budget - The budget of the search.
      * @return Validator::completeModel
      */
-    Validator::pars_container Validator::modelSearch(const dataSet &tr, const dataSet &vs, Network &net) const{
+    Validator::pars_container Validator::modelSearch(const dataSet &tr, const dataSet &vs, Network &net, 
+                                                        const size_t fold, budgetState &budget) const{
         if(this->nets.size() == 0 || this->epochs.size() == 0 || this->taus.size() == 0 || this->etas.size() == 0 ||
             this->alphas.size() == 0 || this->lambdas.size() == 0)
             throw range_error("Some parameter has not been setted.");
@@ -245,7 +769,8 @@ namespace sann{
                     weights = currNet.getWeights();
                 
                 // Search the model.
-                pars_container currModel = this->gridSearch(currNet, tr, vs);
+                const size_t search = (fold * this->nets.size() + i) * this->initNum + j;
+                pars_container currModel = this->gridSearch(currNet, tr, vs, search, budget);
 
                 if(currModel < bestModel){
                     bestModel = currModel; 
@@ -264,9 +789,11 @@ namespace sann{
      * @param trSet - The set to divide.
      * @param setsNum - The number of sets in which divide the training set.
      * @param net - The net on which hase been found the best model. It is returned through reference. 
+     * @param budget - The budget of the search.
      * @return Validator::pars_container - The best model found.
      */
-    Validator::pars_container Validator::modelCrossSearch(const sann::dataSet &trSet, const size_t setsNum, Network &net) const{
+    Validator::pars_container Validator::modelCrossSearch(const sann::dataSet &trSet, const size_t setsNum, Network &net,
+                                                            budgetState &budget) const{
         const size_t step = trSet.inputs.size() / setsNum;
         pars_container bestModel;
 
@@ -274,7 +801,10 @@ namespace sann{
         // #pragma omp parallel for
         for(size_t i = 0; i < setsNum; i++){
             dataSet train{trSet}, validation = train.extractData(i * step, (i+1) * step);
-            pars_container currModel = this->modelSearch(train, validation, net);
+            const size_t copies = this->estimateMemory(train) + this->estimateMemory(validation);
+            budget.hold(copies);
+            pars_container currModel = this->modelSearch(train, validation, net, i, budget);
+            budget.drop(copies);
             
             #pragma omp critical(crossUpdateMin)
             {
@@ -285,6 +815,34 @@ namespace sann{
         return bestModel;
     }
 
+    /**
+     * @brief Ends a search: the report is stored and the selected model is checked.
+     * 
+     * @param model - The selected model.
+     * @param budget - The budget of the search.
+     * @return bool - True if the trained candidate has to be returned as it is, i.e. with CANDIDATE or when the
+     *                deadline has stopped the search.
+     */
+    bool Validator::endSearch(const pars_container &model, budgetState &budget) const{
+        budget.report.seconds = chrono::duration<double>(chrono::steady_clock::now() - budget.start).count();
+        sort(budget.report.unfinished.begin(), budget.report.unfinished.end(), 
+            [](const budgetReport::candidate &a, const budgetReport::candidate &b){ 
+                return a.parameters < b.parameters || (a.parameters == b.parameters && a.epochs < b.epochs); 
+        });
+        {
+            lock_guard<mutex> guard(this->reportLock);
+            this->report = budget.report;
+        }
+
+        if(!budget.report.expired)  return this->finalMode == Validator::CANDIDATE;
+        if(model.valError == MAX_DOUBLE)
+            throw runtime_error("The deadline has come before any training of the model selection.");
+
+        utility::Logger::writeLog("The deadline has stopped the model selection, " + 
+            to_string(budget.report.unfinished.size()) + " combinations are unfinished.", utility::Logger::type::NONE, false);
+        return true;
+    }
+
     /**
      * @brief Selects the best model using the parameters setted for the model selection.
      * 
@@ -295,12 +853,22 @@ namespace sann{
      */ 
     Network Validator::selectModel(const dataSet &tr, const dataSet &vs, Estimator &est) const{
         Network net;
-        Validator::pars_container model = this->modelSearch(tr, vs, net);
+        budgetState budget{this->timeBudget};
+        Validator::pars_container model = this->modelSearch(tr, vs, net, 0, budget);
 
         utility::Logger::writeLog("Selected parameters: \n" + to_string(model.valError) + " | " + to_string(model.pars.eta)
                         + " | " + to_string(model.pars.mi) + " | " + to_string(model.pars.lambda), utility::Logger::type::NONE, false);
 
-        net.train(tr + vs, est, model.pars);
+        // The final net is trained or assessed on a copy of both the sets.
+        budget.hold(this->estimateMemory(tr) + this->estimateMemory(vs));
+        if(this->endSearch(model, budget)){
+            net = move(model.model);
+            this->assess(net, tr + vs, est);
+        }
+        else{
+            if(this->finalMode == Validator::WARM_START)    this->warmStart(model, net);
+            net.train(tr + vs, est, model.pars);
+        }
         return net;
     }
 
@@ -316,9 +884,17 @@ namespace sann{
     Network Validator::selectModelWithCross(const dataSet &trainingSet, sann::Estimator &est, const size_t numOfSet) const{
         Network net;
         pars_container bestModel;
+        budgetState budget{this->timeBudget};
 
-        bestModel = this->modelCrossSearch(trainingSet, numOfSet, net);
-        net.train(trainingSet, est, bestModel.pars);
+        bestModel = this->modelCrossSearch(trainingSet, numOfSet, net, budget);
+        if(this->endSearch(bestModel, budget)){
+            net = move(bestModel.model);
+            this->assess(net, trainingSet, est);
+        }
+        else{
+            if(this->finalMode == Validator::WARM_START)    this->warmStart(bestModel, net);
+            net.train(trainingSet, est, bestModel.pars);
+        }
 
         return net;
     }
@@ -338,9 +914,19 @@ namespace sann{
         Network net;
 
         // Search for the best model and train the net on both training and validation sets.
-        pars_container model = this->modelSearch(tr, vd, net);
+        budgetState budget{this->timeBudget};
+        pars_container model = this->modelSearch(tr, vd, net, 0, budget);
         model.pars.mb = tr.inputs.size() + vd.inputs.size();
-        net.train(tr + vd, ts, trainEst, testEst, model.pars);
+        // The final net is trained or assessed on a copy of both the sets.
+        budget.hold(this->estimateMemory(tr) + this->estimateMemory(vd));
+        if(this->endSearch(model, budget)){
+            net = move(model.model);
+            this->assess(net, tr + vd, trainEst); this->assess(net, ts, testEst);
+        }
+        else{
+            if(this->finalMode == Validator::WARM_START)    this->warmStart(model, net);
+            net.train(tr + vd, ts, trainEst, testEst, model.pars);
+        }
 
         utility::Logger::writeLog("Selected parameters: \nerror: " + to_string(model.valError) + ", tau: " + 
             to_string(model.tau) + ", eta0: " + to_string(model.eta0) + ", etat: " + to_string(model.etat) +  
@@ -366,9 +952,17 @@ namespace sann{
         Network net;
 
         // Search for the best model and train the net on the whole training set.
-        pars_container model = this->modelCrossSearch(tr, numOfSet, net);
+        budgetState budget{this->timeBudget};
+        pars_container model = this->modelCrossSearch(tr, numOfSet, net, budget);
         model.pars.mb = tr.inputs.size();
-        net.train(tr, ts, trainEst, testEst, model.pars);
+        if(this->endSearch(model, budget)){
+            net = move(model.model);
+            this->assess(net, tr, trainEst); this->assess(net, ts, testEst);
+        }
+        else{
+            if(this->finalMode == Validator::WARM_START)    this->warmStart(model, net);
+            net.train(tr, ts, trainEst, testEst, model.pars);
+        }
 
         utility::Logger::writeLog("Selected parameters: \nerror: " + to_string(model.valError) + ", tau: " + 
             to_string(model.tau) + ", eta0: " + to_string(model.eta0) + ", etat: " + to_string(model.etat) +  
@@ -16,9 +16,15 @@
 #include <limits>
 #include <cstddef>
 #include <numeric>
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <memory>
+#include <chrono>
+#include <mutex>
+#include <condition_variable>
 
 // My includes.
-#include "constants.h" 
 #include "dataStructures.h"
 #include "Network.hpp"
 #include "utility/FileManager.hpp"
@@ -31,6 +37,50 @@ namespace sann{
 // It exploits grid search and cross validation for a complete validation phase.
 class Validator{
 public:
+    // ENUMERATION
+
+    // How the selected model is trained at the end of the model selection:
+    // - RETRAIN: it is trained from its starting weights on the whole data.
+    // - CANDIDATE: the candidate trained during the search is returned as it is, with the weights that had the 
+    //              best validation error.
+    // - WARM_START: the training on the whole data starts from the weights of the trained candidate, it only 
+    //               lasts the epochs the candidate has not done yet and continues its learning rate decay.
+    enum finalTraining{RETRAIN, CANDIDATE, WARM_START};
+
+    // STRUCT
+
+    /**
+     * @brief The result of an epoch as stored by the estimators of the validation.
+     * 
+     */
+    struct record{
+        std::size_t epoch;
+        double error, accuracy;
+    };
+
+    /**
+     * @brief The report of the last model selection (see setBudget). The unfinished candidates are the combinations
+     *        whose training has been stopped or never started because of the deadline.
+     * 
+     */
+    struct budgetReport{
+        struct candidate{
+            std::string parameters;         // The net and the hyperparameters, as in the folders of the validation.
+            std::size_t epochs, trained;    // The epochs of the combination and the ones trained before the deadline.
+        };
+
+        bool expired = false;           // True if the deadline has stopped the search.
+        double seconds = 0;             // The time spent by the search.
+        std::size_t peakMemory = 0;     // The peak of the estimated memory of the trainings run at the same time
+                                        // and of the data sets copied by the search.
+        std::vector<candidate> unfinished;
+    };
+
+    // STATIC METHODS
+
+    static void writeRecords(const std::string &fileName, const std::vector<record> &records, const std::size_t size,
+                                const bool binary = false);
+
     //CLASSES
     
     /**
@@ -47,46 +97,55 @@ public:
     * and is needed to hide the copy constructor, the last one is called right before starting the plot method
     * (that could not be overrided). 
     * The attribute errorTreshold could be changed to edit the threshold at which the training error has to 
-    * stop.
-    * Due to speed reason, the plot is done by writing on a file a string with all the csv data.
+    * stop, the attribute binaryResults to write the results in binary format.
+    * Due to speed reason, the results of each epoch are kept in memory and written on file once the training
+    * terminates. The best epoch is just an index in the history.
     */
     class TrValidEstimator : public Estimator{
     private:
         bool earlyStop = false;
-        std::size_t epoch, oldEpoch;
-        std::string filename, results = "", oldResults;
-        double oldError, oldAccuracy;
+        std::size_t epoch, best = 0;
+        std::string filename;
+        std::vector<record> history;
     protected:
         double accuracy, error = 1, errorThreshold = 10e-7;
+        bool binaryResults = false;
     public:
-        TrValidEstimator(const std::string &filename) : filename(filename) {}
+        TrValidEstimator(const std::string &filename) : filename(filename) { this->history.reserve(1024); }
         virtual std::unique_ptr<TrValidEstimator> clone(const std::string &filename) const = 0;
         virtual void init(const std::size_t epoch){
             this->accuracy = this->error = 0; this->epoch = epoch;
-            this->results += std::to_string(epoch) + ',';
         }
         bool stoppingCriteria(){ return this->error <= errorThreshold || earlyStop; }
         virtual void finalize() = 0;
         void plot(){
             this->finalize();
-            this->results += std::to_string(error) + ',' + std::to_string(accuracy) + '\n';
+            this->history.push_back({this->epoch, this->error, this->accuracy});
         }
         void terminate(){
-            if(this->earlyStop){
-                utility::FileManager::writeFile(FILES_DIR + "validation/" + filename + ".csv", this->oldResults);
-                this->epoch = this->oldEpoch;
-            }
-            else
-                utility::FileManager::writeFile(FILES_DIR + "validation/" + filename + ".csv", this->results);
+            this->writeHistory(this->filename);
+            if(this->earlyStop)     this->epoch = this->getEpoch();
         }
-        virtual double getAccuracy() const{ return this->earlyStop ? this->oldAccuracy : this->accuracy; }
-        virtual double getError() const{ return this->earlyStop ? this->oldError : this->error; }
-        virtual double getEpoch() const{ return this->earlyStop ? this->oldEpoch : this->epoch; }
-        void setEarlyStop(){ this->earlyStop = true; }
-        void saveResults(){ 
-            this->oldResults = this->results; this->oldEpoch = this->epoch; 
-            this->oldError = this->error; this->oldAccuracy = this->accuracy;    
+        // Writes the history in another file, e.g. as the one of a shorter training taken from a checkpoint.
+        void writeHistory(const std::string &filename) const{
+            // On early stop only the history until the best epoch is written.
+            std::size_t size = this->earlyStop ? std::min(this->best + 1, this->history.size()) : this->history.size();
+            Validator::writeRecords(utility::FileManager::getFilesDir() + "validation/" + filename + 
+                                    (binaryResults ? ".bin" : ".csv"), this->history, size, binaryResults);
         }
+        virtual double getAccuracy() const{ return this->useBest() ? this->history[best].accuracy : this->accuracy; }
+        virtual double getError() const{ return this->useBest() ? this->history[best].error : this->error; }
+        virtual double getEpoch() const{ return this->useBest() ? this->history[best].epoch : this->epoch; }
+        // Returns the record of an epoch, e.g. the one whose weights have been kept by the training.
+        record getRecord(const std::size_t epoch) const{
+            for(auto rec = this->history.rbegin(); rec != this->history.rend(); ++rec)
+                if(rec->epoch == epoch)     return *rec;
+            throw std::out_of_range("There is no record of the epoch " + std::to_string(epoch) + ".");
+        }
+        void setEarlyStop(){ this->earlyStop = true; }
+        void saveResults(){ this->best = this->history.empty() ? 0 : this->history.size() - 1; }
+    private:
+        bool useBest() const{ return this->earlyStop && this->best < this->history.size(); }
     };
     
     /** To implement the early stop criteria, another estimator is introduced for the validation set.
@@ -95,7 +154,7 @@ public:
     * of the training estimator to true.
     * The three methods update(), clone() and finalize() have to be implemented (read above).
     * Three attribute could be changed: earlyStep changes the number of step in which earlyStop criteria is 
-    * checked, earlyThreshold changes the number of bad checking has to be done before set earlyStop to true,
+    * checked (the validation set is evaluated only on those epochs), earlyThreshold changes the number of bad checking has to be done before set earlyStop to true,
     * errorThreshold is the difference between last saved error and the current one to be sure that we are 
     * going into overfitting.
     */
@@ -104,6 +163,7 @@ public:
         TrValidEstimator &trEst;
         std::size_t currIteration = 0, epoch;
         double oldError = MAX_DOUBLE, oldAccuracy = MAX_DOUBLE;
+        bool best = false;
     protected:
         std::size_t earlyStep = 2, earlyThreshold = 1000;
         double error, accuracy, errorThreshold = 0.2;
@@ -114,14 +174,18 @@ public:
             this->accuracy = this->error = 0; this->epoch = epoch;
         }
         bool stoppingCriteria(){ return false; }
+        // The validation set is only needed on the epochs in which the early stop criteria is checked.
+        virtual bool toEvaluate(const std::size_t epoch){ return epoch % this->earlyStep == 0; }
         virtual void finalize() = 0;
         void plot(){ 
             this->finalize();
+            this->best = false;
             // Each n epoch check if the mse is decreasing. If so, init current iteration to 0.
             if(this->epoch % this->earlyStep == 0){
                 if(this->error < this->oldError){
                     this->oldError = this->error; this->oldAccuracy = this->accuracy;
                     this->currIteration = 0;
+                    this->best = true;
                     this->trEst.saveResults();
                 }
                 else if(this->error - this->oldError > errorThreshold){
@@ -135,6 +199,9 @@ public:
                 this->trEst.setEarlyStop();
         }
         virtual void terminate(){ }
+        // Writes the history, if any, in the file of a shorter training taken from a checkpoint.
+        virtual void writeHistory(const std::string &filename) const{ }
+        bool isBest(){ return this->best; }
         size_t getEpoch(){ return this->epoch; }
     };
 
@@ -148,7 +215,12 @@ private:
     std::vector<float> taus = {}, alphas = {}, lambdas = {};
     std::vector<std::vector<float>> etas;
     std::vector<Network> nets = {};
-    std::size_t initNum = 1;
+    std::size_t initNum = 1, validationSize = 0, batchSize = 1;
+    finalTraining finalMode = RETRAIN;
+    double timeBudget = 0;          // The seconds given to the search (0 = no deadline).
+    std::size_t memoryBudget = 0;   // The bytes given to the trainings run at the same time (0 = no cap).
+    mutable budgetReport report;
+    mutable std::mutex reportLock;  // The selections of different threads may end together.
     const std::shared_ptr<TrValidEstimator> trainingEst;
     const std::shared_ptr<VdValidEstimator> validationEst;
 
@@ -158,6 +230,9 @@ private:
         parameters pars = {};
         double valError = MAX_DOUBLE, accuracy = 0, trainError = MAX_DOUBLE;
         float tau, eta0, etat;
+        std::size_t epochs = 0;
+        std::size_t trained = 0;    // The epochs trained by the weights of the candidate.
+        Network model = {}; // The trained candidate, kept only if it is not retrained.
 
         bool operator < (const pars_container& other){
             return valError < other.valError || (valError == other.valError && 
@@ -165,12 +240,44 @@ private:
         }
     };
 
+    // The state of a search with a budget, shared by the threads of the grid search.
+    struct budgetState{
+        std::chrono::steady_clock::time_point start, deadline;
+        std::size_t memory = 0;     // The estimated memory of the running trainings.
+        std::size_t held = 0;       // The estimated memory of the data sets copied by the search.
+        std::mutex lock;
+        std::condition_variable released;
+        budgetReport report;
+
+        budgetState(const double seconds);
+        bool admit(const std::size_t memory, const std::size_t cap);
+        void release(const std::size_t memory);
+        void hold(const std::size_t memory);
+        void drop(const std::size_t memory);
+        void addUnfinished(const std::string &parameters, const std::size_t epochs, const std::size_t trained);
+    };
+
     // METHODS
 
+    std::string getParametersName(const sann::Network &net, const sann::parameters &hyperP, 
+                                    const std::vector<double> &etaDecay) const;
     std::string getValidatorName(sann::Network &net, const sann::parameters &hyperP, const std::vector<double> &etaDecay) const;
-    pars_container gridSearch(sann::Network &net, const sann::dataSet &tr, const sann::dataSet &vs) const;
-    pars_container modelSearch(const sann::dataSet &tr, const sann::dataSet &vs, Network &net) const;
-    pars_container modelCrossSearch(const sann::dataSet &trSet, const size_t sets, Network &net) const;
+    pars_container getCombination(const std::size_t index, const std::size_t trainingSize) const;
+    bool keepsCandidates() const;
+    std::size_t estimateMemory(const sann::Network &net, const sann::dataSet &tr, const sann::dataSet &vs, 
+                                const std::size_t trajectories) const;
+    std::size_t estimateMemory(const sann::dataSet &set) const;
+    void setResults(pars_container &model, sann::Network &net, const TrValidEstimator &est, 
+                    const sann::dataSet &vs) const;
+    pars_container gridSearch(sann::Network &net, const sann::dataSet &tr, const sann::dataSet &vs, 
+                                const std::size_t search, budgetState &budget) const;
+    pars_container modelSearch(const sann::dataSet &tr, const sann::dataSet &vs, Network &net, 
+                                const std::size_t fold, budgetState &budget) const;
+    pars_container modelCrossSearch(const sann::dataSet &trSet, const size_t sets, Network &net, 
+                                    budgetState &budget) const;
+    bool endSearch(const pars_container &model, budgetState &budget) const;
+    void assess(Network &net, const sann::dataSet &set, sann::Estimator &est) const;
+    void warmStart(pars_container &model, Network &net) const;
 
 public:
 
@@ -208,6 +315,11 @@ public:
     void addModelSelectionNetwork(const std::vector<Network> &nets);
     void addModelSelectionWeightInit(const std::vector<initializer> &initializers);
     void setRandomInit(const std::size_t n);
+    void setValidationSize(const std::size_t n);
+    void setBatchedSearch(const std::size_t k);
+    void setFinalTraining(const Validator::finalTraining mode);
+    void setBudget(const double seconds, const std::size_t memory = 0);
+    Validator::budgetReport getBudgetReport() const;
     double expectedRisk(sann::Network &net, const sann::dataSet &vs) const;
     Network selectModel(const sann::dataSet &tr, const sann::dataSet &vs, sann::Estimator &est) const;
     Network selectModelWithCross(const sann::dataSet &trainingSet, sann::Estimator &est, const std::size_t numOfSet = 4) const;
@@ -1,22 +0,0 @@
-/*******************************************************
- *                                                     *
- *  sann: Neural Network library                       *
- *                                                     *
- *  CONSTANT                                           *
- *                                                     *
- *  Giulio Auriemma                                    *
- *                                                     *
- *******************************************************/
-#ifndef S_CONSTANT_S
-#define S_CONSTANT_S
-
-#include <string>
-
-namespace sann{
-    const std::string BASE_DIR = "/home/doctor-sushi/Documents/C++Projects/sann/"; // The base directory.
-    const std::string FILES_DIR = BASE_DIR + "files/"; // The files directory
-    const std::string DATA_SET = "cup";
-}
-
-
-#endif
@@ -14,26 +14,38 @@
 #include <vector>
 #include <functional>
 #include <iostream>
+#include <cstdint>
 
 namespace sann{
 
+class Network;
+
 /**
- * @brief This is the struct that represents the dataset to handle. It has three attributes:
+ * @brief This is the struct that represents the dataset to handle. It has four attributes:
  *         - names : The name of each pattern.
  *         - inputs : The inputs vector of each pattern.
  *         - results : The target results of each pattern.
+ *         - active : Only for sparse data sets, the indexes of the inputs equal to 1 of each pattern, in
+ *                    increasing order (all the other inputs are 0). The inputs of a sparse data set are empty.
  * 
  */
 typedef struct ds{
     std::vector<std::string> names; 
     std::vector<std::vector<double>> inputs;
     std::vector<std::vector<double>> results;
+    std::vector<std::vector<std::size_t>> active;
+
+    /**
+     * @brief Returns true if the patterns are stored as the indexes of their active inputs.
+     */
+    inline bool isSparse() const{ return !this->active.empty(); }
 
     struct ds operator+(const struct ds x) const{
-        struct ds newDs{names, inputs, results};
+        struct ds newDs{names, inputs, results, active};
         newDs.names.insert(newDs.names.end(), x.names.begin(), x.names.end());
         newDs.inputs.insert(newDs.inputs.end(), x.inputs.begin(), x.inputs.end());
         newDs.results.insert(newDs.results.end(), x.results.begin(), x.results.end());
+        newDs.active.insert(newDs.active.end(), x.active.begin(), x.active.end());
         return newDs;
     }
 
@@ -58,9 +70,16 @@ typedef struct ds{
         // Build and erase the new dataset.
         std::vector<std::vector<double>> newInputs{starti, endi}, newResults{startr, endr};
         std::vector<std::string> newNames{startn, endn};
+        std::vector<std::vector<std::size_t>> newActive;
+        if(this->isSparse()){
+            auto starta = this->active.begin() + start, enda = end >= this->active.size() ? 
+                            this->active.end() : this->active.begin() + end;
+            newActive.assign(starta, enda);
+            this->active.erase(starta, enda);
+        }
         this->inputs.erase(starti, endi); this->results.erase(startr, endr); this->names.erase(startn, endn);
 
-        return {newNames, newInputs, newResults};
+        return {newNames, newInputs, newResults, newActive};
     }
 } dataSet;
 
@@ -74,6 +93,20 @@ typedef struct ds{
  *        - update(struct p &par, const size_t epoch) : This function is called every epoch, and the argument
  *                  are the struct on which it is called and the epoch. This attribute allows to change the 
  *                  hyperparameters every epoch.
+ *        - eval_step : The test set is evaluated once every eval_step epochs (1 by default, 0 = never).
+ *        - eval_size : The number of patterns of the test set on which evaluate the net. They are randomly 
+ *                  chosen once at the beginning of the training (0 by default = the whole test set).
+ *        - eval_async : If true, the test set is evaluated in a separate thread on a snapshot of the weights,
+ *                  while the net trains on the same epoch (false by default).
+ *        - keep_best : If true, the weights on which the test estimator saw its best outputs are kept and
+ *                  restored at the end of the training (false by default).
+ *        - shuffle : If true, the training set is visited in a different random order every epoch (false by
+ *                  default). The order only depends on shuffle_seed and on the epoch.
+ *        - checkpoints : The epochs at which checkpoint is called, in increasing order (none by default).
+ *        - checkpoint(Network &net, const size_t epoch) : It is called at the start of each epoch in checkpoints,
+ *                  with a copy of the net as the training would return it if max_epoch was that epoch (with the
+ *                  best weights if keep_best). So the results of the shorter trainings can be taken from a
+ *                  longer one.
  */
 typedef struct p{
     std::size_t max_epoch, mb;
@@ -81,6 +114,11 @@ typedef struct p{
     float mi;
     float lambda;
     std::function<void(struct p &par, const size_t epoch)> update;
+    std::size_t eval_step = 1, eval_size = 0;
+    bool eval_async = false, keep_best = false, shuffle = false;
+    std::uint64_t shuffle_seed = 0;
+    std::vector<std::size_t> checkpoints = {};
+    std::function<void(sann::Network &net, const std::size_t epoch)> checkpoint;
 } parameters;
 
 typedef std::vector<std::vector<double>> weightsMatrix;
@@ -12,16 +12,48 @@
 
 namespace sann{
 namespace math{
+    /**
+     * @brief Approximates tanh with a rational function of degree 13/6 (the odd numerator and the even denominator
+     *        are evaluated with Horner on x^2). Outside of [-7.9053, 7.9053] tanh is 1 up to the error bound, so
+     *        the input is clamped. The maximum absolute error is 2.6e-7.
+     * 
+     * @param x - The input.
+     * @return double - The approximated tanh.
+     */
+    static inline double rationalTanh(double x){
+        const double clamp = 7.90531110763549805;
+        x = x < -clamp ? -clamp : (x > clamp ? clamp : x);
+        const double x2 = x * x;
+
+        double p = -2.76076847742355e-16;
+        p = p * x2 + 2.00018790482477e-13;
+        p = p * x2 - 8.60467152213735e-11;
+        p = p * x2 + 5.12229709037114e-08;
+        p = p * x2 + 1.48572235717979e-05;
+        p = p * x2 + 6.37261928875436e-04;
+        p = p * x2 + 4.89352455891786e-03;
+
+        double q = 1.19825839466702e-06;
+        q = q * x2 + 1.18534705686654e-04;
+        q = q * x2 + 2.26843463243900e-03;
+        q = q * x2 + 4.89352518554385e-03;
+
+        return x * p / q;
+    }
+
     /**
      * @brief The default constructor.
      * 
      * @param func - The function.
      * @param derivative - The derivative of the function.
+     * @param outputDerivative - The derivative of the function computed from its output, f'(x) = g(f(x)). It is 
+     *                           optional, since not every function has it.
      */
-    Func::Func(const std::function<double(const double)> &func, const std::function<double(const double)> &derivative) :
-         func(func), deriv(derivative){}
+    Func::Func(const std::function<double(const double)> &func, const std::function<double(const double)> &derivative,
+        const std::function<double(const double)> &outputDerivative) : 
+         func(func), deriv(derivative), outDeriv(outputDerivative){}
 
-    Func::Func(const Func &func): func(func.func), deriv(func.deriv){}
+    Func::Func(const Func &func): func(func.func), deriv(func.deriv), outDeriv(func.outDeriv){}
     
     /**
      * @brief Computes the function.
@@ -43,6 +75,26 @@ namespace math{
         return this->deriv(input);
     }
 
+    /**
+     * @brief Computes the derivative of the function from its output. It can be called only if the function has
+     *        the derivative wrt the output.
+     * 
+     * @param output - The output of the function.
+     * @return double - The computed derivative.
+     */
+    double Func::outputDerivative(const double output) const{
+        return this->outDeriv(output);
+    }
+
+    /**
+     * @brief Returns true if the derivative can be computed from the output of the function.
+     * 
+     * @return bool - True if the function has the derivative wrt its output.
+     */
+    bool Func::hasOutputDerivative() const{
+        return static_cast<bool>(this->outDeriv);
+    }
+
 
     // STATIC FUNCTION
 
@@ -57,6 +109,9 @@ namespace math{
         },
         [](const double x) -> double{
             return 1;
+        },
+        [](const double y) -> double{
+            return 1;
         }
     );
 
@@ -73,6 +128,9 @@ namespace math{
         [](const double x) -> double{ // fs(x) (1 - fs(x))
             double ex = exp(x);
             return ex / pow(ex + 1, 2);
+        },
+        [](const double y) -> double{ // y (1 - y)
+            return y * (1 - y);
         }
     );
 
@@ -87,6 +145,9 @@ namespace math{
         },
         [](const double x) -> double{ // 1 - ftanh(x)^2
             return 1 - pow((2 / (1 + exp(-x * 2))) - 1, 2);
+        },
+        [](const double y) -> double{ // 1 - y^2
+            return 1 - y * y;
         }
     );
 
@@ -101,6 +162,51 @@ namespace math{
         },
         [](const double x) -> double{ // x > 0 ? 1 : 0;
             return x > 0 ? 1 : 0;
+        },
+        [](const double y) -> double{ // y > 0 iff x > 0
+            return y > 0 ? 1 : 0;
+        }
+    );
+
+    // APPROXIMATED FUNCTION
+
+    const double Func::FAST_SIGMOID_ERROR = 1.5e-7;
+    const double Func::FAST_TANH_ERROR = 3e-7;
+
+    /**
+     * @brief Returns the sigmoid computed as 0.5 + 0.5 tanh(x / 2) with the rational tanh. Its maximum absolute
+     *        error is FAST_SIGMOID_ERROR.
+     * 
+     * @return Func - The approximated sigmoid function.
+     */
+    Func Func::fastSigmoid = Func(
+        [](const double x) -> double{
+            return 0.5 + 0.5 * rationalTanh(0.5 * x);
+        },
+        [](const double x) -> double{
+            double y = 0.5 + 0.5 * rationalTanh(0.5 * x);
+            return y * (1 - y);
+        },
+        [](const double y) -> double{
+            return y * (1 - y);
+        }
+    );
+
+    /**
+     * @brief Returns the tanh computed with a rational approximation. Its maximum absolute error is FAST_TANH_ERROR.
+     * 
+     * @return Func - The approximated tanh function.
+     */
+    Func Func::fastTanH = Func(
+        [](const double x) -> double{
+            return rationalTanh(x);
+        },
+        [](const double x) -> double{
+            double y = rationalTanh(x);
+            return 1 - y * y;
+        },
+        [](const double y) -> double{
+            return 1 - y * y;
         }
     );
 }
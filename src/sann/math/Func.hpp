@@ -20,7 +20,9 @@ namespace sann{
 
 namespace math{
 
-/// This class represent a mathematical function used as activation function.
+/// This class represent a mathematical function used as activation function. The derivative can be also given
+/// in terms of the output of the function (e.g. y(1 - y) for the sigmoid): in that case the back propagation uses
+/// the outputs already computed and does not evaluate the function again.
 class Func{
 
 private:
@@ -29,11 +31,13 @@ private:
 
     std::function<double(const double)> func; // The function.
     std::function<double(const double)> deriv; // The function's derivative.
+    std::function<double(const double)> outDeriv; // The function's derivative wrt its output, if any.
 
 public:
     
     // Default constructor.
-    Func(const std::function<double(const double)> &func, const std::function<double(const double)> &derivative);
+    Func(const std::function<double(const double)> &func, const std::function<double(const double)> &derivative,
+            const std::function<double(const double)> &outputDerivative = nullptr);
     // Copy constructor.
     Func(const Func &func);
 
@@ -41,6 +45,8 @@ public:
 
     double call(const double input) const;
     double derivative(const double input) const;
+    double outputDerivative(const double output) const;
+    bool hasOutputDerivative() const;
 
     // STANDARD FUNCTION
 
@@ -48,6 +54,15 @@ public:
     static Func sigmoid;
     static Func tanH;
     static Func ReLU;
+
+    // APPROXIMATED FUNCTION
+
+    // They use a rational approximation instead of exp, their maximum absolute error wrt the exact ones is below
+    // the given bounds on the whole real line (twice the bounds for their derivatives).
+    static Func fastSigmoid;
+    static Func fastTanH;
+    static const double FAST_SIGMOID_ERROR;
+    static const double FAST_TANH_ERROR;
 };
 
 }
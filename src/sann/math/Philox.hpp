@@ -0,0 +1,158 @@
+/*******************************************************
+ *                                                     *
+ *  sann: Neural Network library                       *
+ *                                                     *
+ *  PHILOX CLASS HEADER                                *
+ *                                                     *
+ *  Giulio Auriemma                                    *
+ *                                                     *
+ *******************************************************/
+
+#ifndef S_MATH_PHILOX_S
+#define S_MATH_PHILOX_S
+
+// System libraries include.
+#include <cstdint>
+#include <cstddef>
+#include <cmath>
+
+namespace sann{
+namespace math{
+
+/// This class is the Philox4x32-10 counter-based generator (Salmon et al., "Parallel random numbers: as easy as
+/// 1, 2, 3"). Every block of four random numbers is a pure function of a key (the seed) and a 128 bit counter:
+/// the lower 64 bits are the position inside the stream, the upper 64 bits are the stream itself. So streams
+/// with different ids are independent, and any stream can be created anywhere without sharing state.
+class Philox{
+private:
+    // ATTRIBUTES
+
+    uint64_t key, stream, position = 0;
+    uint32_t buffer[4];
+    unsigned used = 4;
+
+    // METHODS
+
+    /**
+     * @brief Computes the block of four random numbers of the given counter.
+     *
+     * @param key - The key.
+     * @param position - The lower half of the counter.
+     * @param stream - The upper half of the counter.
+     * @param out - The four random numbers.
+     */
+    static inline void block(const uint64_t key, const uint64_t position, const uint64_t stream, uint32_t out[4]){
+        uint32_t c0 = (uint32_t)position, c1 = (uint32_t)(position >> 32), c2 = (uint32_t)stream,
+            c3 = (uint32_t)(stream >> 32), k0 = (uint32_t)key, k1 = (uint32_t)(key >> 32);
+
+        for(int r = 0; r < 10; ++r){
+            uint64_t p0 = (uint64_t)0xD2511F53 * c0, p1 = (uint64_t)0xCD9E8D57 * c2;
+            uint32_t n0 = (uint32_t)(p1 >> 32) ^ c1 ^ k0, n2 = (uint32_t)(p0 >> 32) ^ c3 ^ k1;
+            c1 = (uint32_t)p1; c3 = (uint32_t)p0; c0 = n0; c2 = n2;
+            k0 += 0x9E3779B9; k1 += 0xBB67AE85;
+        }
+
+        out[0] = c0; out[1] = c1; out[2] = c2; out[3] = c3;
+    }
+
+    /**
+     * @brief Converts two random numbers in a double uniformly distributed in [0, 1) with 53 random bits.
+     */
+    static inline double toUnit(const uint32_t hi, const uint32_t lo){
+        return (((uint64_t)hi << 21) ^ (lo >> 11)) * (1.0 / 9007199254740992.0);
+    }
+
+public:
+    // CONSTRUCTORS
+
+    /**
+     * @brief Creates the generator of a stream.
+     *
+     * @param seed - The seed, shared by all the streams of the same run.
+     * @param stream - The id of the stream.
+     */
+    Philox(const uint64_t seed = 0, const uint64_t stream = 0) : key(seed), stream(stream){}
+
+    // METHODS
+
+    /**
+     * @brief Returns the next 32 bit random number of the stream.
+     */
+    inline uint32_t next(){
+        if(this->used == 4){
+            block(this->key, this->position++, this->stream, this->buffer);
+            this->used = 0;
+        }
+        return this->buffer[this->used++];
+    }
+
+    /**
+     * @brief Returns a random number uniformly distributed in [0, 1).
+     */
+    inline double uniform(){
+        uint32_t hi = this->next();
+        return toUnit(hi, this->next());
+    }
+
+    /**
+     * @brief Returns the seed from which the generator has been created.
+     */
+    inline uint64_t getSeed() const{ return this->key; }
+
+    /**
+     * @brief Fills an array with random numbers uniformly distributed in [min, max). Each iteration works on
+     *        its own counter, so the loop has no dependencies and can be vectorized.
+     *
+     * @tparam T - The type of the elements of the array.
+     * @param out - The array to fill.
+     * @param n - The size of the array.
+     * @param min - The lower bound.
+     * @param max - The upper bound.
+     */
+    template <typename T>
+    void fillUniform(T *out, const std::size_t n, const double min, const double max){
+        const double range = max - min;
+        const std::size_t blocks = n / 2;
+
+        for(std::size_t b = 0; b < blocks; ++b){
+            uint32_t r[4];
+            block(this->key, this->position + b, this->stream, r);
+            out[2 * b] = min + toUnit(r[0], r[1]) * range;
+            out[2 * b + 1] = min + toUnit(r[2], r[3]) * range;
+        }
+        this->position += blocks;
+
+        if(n % 2 == 1)  out[n - 1] = min + this->uniform() * range;
+    }
+
+    /**
+     * @brief Fills an array with random numbers taken from a Gaussian distribution, using the Box-Muller
+     *        transform on each block.
+     *
+     * @tparam T - The type of the elements of the array.
+     * @param out - The array to fill.
+     * @param n - The size of the array.
+     * @param mean - The mean of the distribution.
+     * @param stddev - The standard deviation.
+     */
+    template <typename T>
+    void fillNormal(T *out, const std::size_t n, const double mean, const double stddev){
+        const std::size_t blocks = (n + 1) / 2;
+
+        for(std::size_t b = 0; b < blocks; ++b){
+            uint32_t r[4];
+            block(this->key, this->position + b, this->stream, r);
+            double radius = stddev * std::sqrt(-2.0 * std::log(1.0 - toUnit(r[0], r[1]))),
+                angle = 6.283185307179586 * toUnit(r[2], r[3]);
+
+            out[2 * b] = mean + radius * std::cos(angle);
+            if(2 * b + 1 < n)   out[2 * b + 1] = mean + radius * std::sin(angle);
+        }
+        this->position += blocks;
+    }
+};
+
+}
+}
+
+#endif
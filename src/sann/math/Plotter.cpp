@@ -11,10 +11,11 @@
 
 // Other system includes.
 #include <stdexcept>
-#include <fstream>
+#include <cstring>
+#include <cstdint>
 
 // My includes
-#include "../constants.h"
+#include "../utility/FileManager.hpp"
 
 using namespace std;
 
@@ -23,50 +24,227 @@ namespace math {
 
     /**
      * @brief Builds a new Plotter. If a file with the same name as the one passed to the constructor exists,
-     *        it will be cleaned if clean flag is up. 
+     *        it will be cleaned if clean flag is up. The files are opened by the writer thread the first time
+     *        something has to be written on them.
      * 
-     * @param plotName - The name of the file on which plot (.csv will be postponed).
+     * @param plotName - The name of the file on which plot (.csv or .bin will be postponed).
      * @param clean - True if the file must be cleaned.
+     * @param fmt - The format in which functions are plotted. Points are always plotted as csv.
      */
-    Plotter::Plotter(const string &plotName, const bool clean){
-        this->plotName = plotName;
-        
+    Plotter::Plotter(const string &plotName, const bool clean, const format fmt) : plotName(plotName), fmt(fmt){
         if(plotName.size() > 0){
             auto opt = clean ? ios::out | ios::trunc : ios::out;
             
             // Clear file if they exist.
-            if(fstream{FILES_DIR + this->plotName + ".csv"})
-                ofstream file(FILES_DIR + this->plotName + ".csv", opt);
-            
-            if(fstream{FILES_DIR + this->plotName + ".points.csv"})
-                ofstream file(FILES_DIR + this->plotName + ".points.csv", opt);
+            for(auto extension : {".csv", ".bin", ".points.csv"})
+                if(fstream{utility::FileManager::getFilesDir() + this->plotName + extension})
+                    ofstream file(utility::FileManager::getFilesDir() + this->plotName + extension, opt);
+        }
+    }
+
+    /**
+     * @brief Builds a plotter on the same files of another one. The data buffered by the other one are not copied,
+     *        the new plotter appends its own.
+     * 
+     * @param plt - The plotter to copy.
+     */
+    Plotter::Plotter(const Plotter &plt) : plotName(plt.plotName), fmt(plt.fmt){ }
+
+    // OPERATORS
+
+    /**
+     * @brief Writes the data buffered until now, then plots on the same files of another plotter (see the copy
+     *        constructor).
+     * 
+     * @param plt - The plotter to copy.
+     * @return Plotter& - This plotter.
+     */
+    Plotter& Plotter::operator=(const Plotter &plt){
+        if(this != &plt){
+            this->out.reset();
+            this->plotName = plt.plotName;
+            this->fmt = plt.fmt;
         }
+        return *this;
     }
 
     // METHODS
 
+    /**
+     * @brief Returns the buffers of the plotter, creating them the first time.
+     * 
+     * @return Plotter::writer& - The buffers.
+     */
+    Plotter::writer& Plotter::getWriter() const{
+        if(!this->out)  this->out.reset(new writer{utility::FileManager::getFilesDir() + this->plotName});
+        return *this->out;
+    }
+
+    /**
+     * @brief Writes on the files all the data plotted until now and waits for the writer to finish.
+     * 
+     */
+    void Plotter::flush() const{
+        if(this->out)   this->out->flush();
+    }
+
+    /**
+     * @brief Creates the buffers of the files with the given path. The thread is started by the first push.
+     * 
+     * @param path - The files without the extension.
+     */
+    Plotter::writer::writer(const string &path) : path(path){ }
+
+    /**
+     * @brief Writes all the buffered data, then stops the writer thread and closes the files.
+     * 
+     */
+    Plotter::writer::~writer(){
+        this->pushBuffers();
+        if(this->thread.joinable()){
+            {
+                lock_guard<mutex> lock(this->mtx);
+                this->stop = true;
+            }
+            this->cv.notify_all();
+            this->thread.join();
+        }
+    }
+
+    /**
+     * @brief Hands a chunk of data to the writer thread, starting it if it is not running yet.
+     * 
+     * @param file - The file on which write.
+     * @param extension - The extension of the file, needed to open it.
+     * @param data - The data to write.
+     */
+    void Plotter::writer::push(ofstream &file, const string &extension, string &&data){
+        if(data.empty())    return;
+        if(!this->thread.joinable())    this->thread = std::thread(&Plotter::writer::writeLoop, this);
+
+        {
+            lock_guard<mutex> lock(this->mtx);
+            this->jobs.push_back({&file, extension, move(data)});
+        }
+        this->cv.notify_all();
+    }
+
+    /**
+     * @brief Hands the buffered columns to the writer thread as a binary block.
+     * 
+     */
+    void Plotter::writer::pushColumns(){
+        uint64_t rowsNum = this->columns.empty() ? 0 : this->columns[0].size(), colsNum = this->columns.size();
+        if(rowsNum == 0)    return;
+
+        string block(sizeof(uint64_t) * 2 + sizeof(double) * rowsNum * colsNum, '\0');
+        char *data = &block[0];
+        
+        memcpy(data, &rowsNum, sizeof(uint64_t)); data += sizeof(uint64_t);
+        memcpy(data, &colsNum, sizeof(uint64_t)); data += sizeof(uint64_t);
+        for(auto &col : this->columns){
+            memcpy(data, col.data(), sizeof(double) * rowsNum); data += sizeof(double) * rowsNum;
+            col.clear();
+        }
+
+        this->push(this->file, ".bin", move(block));
+    }
+
+    /**
+     * @brief Hands all the buffered data to the writer thread.
+     * 
+     */
+    void Plotter::writer::pushBuffers(){
+        this->pushColumns();
+        this->push(this->file, ".csv", this->rows.str());
+        this->push(this->pointsFile, ".points.csv", this->points.str());
+        this->rows.str(""); this->points.str("");
+    }
+
+    /**
+     * @brief The body of the writer thread: it writes the chunks of data in the same order in which they have
+     *        been pushed, until the plotter is destroyed.
+     * 
+     */
+    void Plotter::writer::writeLoop(){
+        unique_lock<mutex> lock(this->mtx);
+
+        while(true){
+            this->cv.wait(lock, [this]{ return this->stop || !this->jobs.empty(); });
+            if(this->jobs.empty())  break;
+
+            job currJob = move(this->jobs.front());
+            this->jobs.pop_front();
+            this->writing = true;
+            lock.unlock();
+
+            if(!currJob.file->is_open())
+                currJob.file->open(this->path + currJob.extension, ios::out | ios::app | ios::binary);
+            currJob.file->write(currJob.data.data(), currJob.data.size());
+
+            lock.lock();
+            this->writing = false;
+            this->cv.notify_all();
+        }
+    }
+
+    /**
+     * @brief Writes on the files all the data buffered until now and waits for the writer to finish.
+     * 
+     */
+    void Plotter::writer::flush(){
+        this->pushBuffers();
+
+        unique_lock<mutex> lock(this->mtx);
+        this->cv.wait(lock, [this]{ return this->jobs.empty() && !this->writing; });
+        // The writer is idle, so the files can be safely touched.
+        if(this->file.is_open())        this->file.flush();
+        if(this->pointsFile.is_open())  this->pointsFile.flush();
+    }
+
     /**
      * @brief Plots a list of vector as columns of csv file.
      * 
      * @param list - The list of columns vector.
      */
     void Plotter::plotFunction(const std::initializer_list<vector<double>> &list) const{
-        if(plotName.size() > 0){
-            ofstream file(FILES_DIR + this->plotName + ".csv", ios::out | ios::app);
-
+        // An empty list has nothing to plot.
+        if(plotName.size() > 0 && list.size() > 0){
             for(auto vec = list.begin(); list.size() > 1 && vec < list.end() - 1; vec++)
                 if(vec->size() != (vec + 1)->size())
                     throw invalid_argument("The sizes of vectors do not match.");
+
+            writer &out = this->getWriter();
+
+            if(this->fmt == format::BINARY){
+                // A new block is started when the number of columns changes.
+                if(out.columns.size() != list.size()){
+                    out.pushColumns();
+                    out.columns.resize(list.size());
+                }
+
+                size_t i = 0;
+                for(auto vec = list.begin(); vec < list.end(); vec++, i++)
+                    out.columns[i].insert(out.columns[i].end(), vec->begin(), vec->end());
+
+                if(!out.columns.empty() && 
+                    out.columns[0].size() * out.columns.size() * sizeof(double) >= BUFFER_SIZE)
+                    out.pushColumns();
+                return;
+            }
             
             for(size_t i = 0; i < list.begin()->size(); i++){
                 for(auto vec = list.begin(); vec < list.end(); vec++){
-                    file << (*vec)[i];
-                    if(vec < list.end() - 1)    file << ",";
+                    out.rows << (*vec)[i];
+                    if(vec < list.end() - 1)    out.rows << ",";
                 }
-                file << endl;
+                out.rows << '\n';
             }
 
-            file.close();
+            if((size_t)out.rows.tellp() >= BUFFER_SIZE){
+                out.push(out.file, ".csv", out.rows.str());
+                out.rows.str("");
+            }
         }        
     }
 
@@ -77,18 +255,10 @@ namespace math {
      * @param y - The y of the function.
      */
     void Plotter::plotFunction(const std::vector<double> &x, const std::vector<double> &y) const{
-        if(plotName.size() > 0){
-            ofstream file(FILES_DIR + this->plotName + ".csv", ios::out | ios::app);
-
-            if(x.size() != y.size())
-                throw invalid_argument("The sizes of two sets do not match.");
+        if(x.size() != y.size())
+            throw invalid_argument("The sizes of two sets do not match.");
 
-            for(size_t i = 0; i < x.size(); i++){
-                file << x[i] << "," << y[i] << endl;
-            }
-
-            file.close();
-        }
+        this->plotFunction({x, y});
     }
 
     /**
@@ -98,15 +268,12 @@ namespace math {
      * @param fnc - The function itself.
      */
     void Plotter::plotFunction(const std::vector<double> &x, std::function<double(double)> fnc) const{
-        if(plotName.size() > 0){
-            ofstream file(FILES_DIR + this->plotName + ".csv", ios::out | ios::app);
+        vector<double> y(x.size());
 
-            for(size_t i = 0; i < x.size(); i++){
-                file << x[i] << "," << fnc(x[i]) << endl;
-            }
+        for(size_t i = 0; i < x.size(); i++)
+            y[i] = fnc(x[i]);
 
-            file.close();
-        }
+        this->plotFunction({x, y});
     }
 
     /**
@@ -118,17 +285,20 @@ namespace math {
      */
     void Plotter::plotPoints(const std::vector<double> &x, const std::vector<double> &y, const std::vector<short> &classes) const{
         if(plotName.size() > 0){
-            ofstream file(FILES_DIR + this->plotName + ".points.csv", ios::out | ios::app);
-            
             if(x.size() != y.size() || (classes.size() > 0 && classes.size() != x.size()))
                 throw invalid_argument("The sizes of two sets do not match.");
 
+            writer &out = this->getWriter();
+
             for(size_t i = 0; i < x.size(); i++){
                 short currClass = classes.size() > 0 ? classes[i] : 0;
-                file << x[i] << "," << y[i] << "," << currClass << endl;
+                out.points << x[i] << "," << y[i] << "," << currClass << '\n';
             }
 
-            file.close();
+            if((size_t)out.points.tellp() >= BUFFER_SIZE){
+                out.push(out.pointsFile, ".points.csv", out.points.str());
+                out.points.str("");
+            }
         }
     }
 }
@@ -14,18 +14,82 @@
 // System libraries includes.
 #include <vector>
 #include <string>
+#include <sstream>
+#include <fstream>
 #include <functional>
 #include <initializer_list>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 
-namespace sann{     
+namespace sann{
 namespace math {
-/// This class allows to plot functions and data on csv file. 
+/// This class allows to plot functions and data on csv file. The rows are buffered in memory and handed to a
+/// background thread that writes them on the file, that is kept open until the plotter is destroyed. The thread
+/// is started the first time something has to be written, and a copy of a plotter appends to the same files
+/// with its own buffers.
+/// The functions can be also plotted in a binary columnar format: the file (.bin) is a sequence of blocks,
+/// each one made by the number of rows and of columns (two uint64) followed by the columns (doubles).
 class Plotter{
+public:
+    // ENUMERATION
+
+    enum class format{CSV, BINARY};
+
+private:
+    // STRUCT
+
+    struct job{
+        std::ofstream *file;
+        std::string extension, data;
+    };
+
+    // The buffers of a plotter and the thread that writes them.
+    struct writer{
+        std::string path;   // The files without the extension.
+        std::ofstream file, pointsFile;
+        std::ostringstream rows, points;
+        std::vector<std::vector<double>> columns;
+        std::deque<job> jobs;
+        std::thread thread;
+        std::mutex mtx;
+        std::condition_variable cv;
+        bool stop = false, writing = false;
+
+        writer(const std::string &path);
+        ~writer();
+
+        void push(std::ofstream &file, const std::string &extension, std::string &&data);
+        void pushColumns();
+        void pushBuffers();
+        void writeLoop();
+        void flush();
+    };
+
+    // ATTRIBUTES
+
     std::string plotName;
+    format fmt;
+    mutable std::unique_ptr<writer> out;    // Created the first time something is plotted.
+
+    static const std::size_t BUFFER_SIZE = 1 << 16;
+
+    // METHODS
+
+    writer& getWriter() const;
 
 public:
 
-    Plotter(const std::string &plotName, const bool clean = true);
+    Plotter(const std::string &plotName, const bool clean = true, const format fmt = format::CSV);
+    Plotter(const Plotter &plt);
+    Plotter(Plotter &&plt) = default;
+
+    // OPERATORS
+
+    Plotter& operator=(const Plotter &plt);
+    Plotter& operator=(Plotter &&plt) = default;
 
     // METHODS
 
@@ -33,9 +97,10 @@ public:
     void plotFunction(const std::vector<double> &x, const std::vector<double> &y) const;
     void plotFunction(const std::vector<double> &x, std::function<double(double)> fnc) const;
     void plotPoints(const std::vector<double> &x, const std::vector<double> &y, const std::vector<short> &classes = {}) const;
+    void flush() const;
 };
 
 }
 }
 
-#endif
\ No newline at end of file
+#endif
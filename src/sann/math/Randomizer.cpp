@@ -17,7 +17,8 @@ namespace sann{
 namespace math{
     
     //Init a random seed.
-    int Randomizer::initSeed = []() -> int { srand(time(NULL)); return 1; }();
+    std::atomic<uint64_t> Randomizer::masterSeed{(uint64_t)time(NULL)};
+    std::atomic<uint64_t> Randomizer::nextStream{0};
 
 }
 }
\ No newline at end of file
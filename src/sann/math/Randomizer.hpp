@@ -16,23 +16,67 @@
 #include <stdlib.h>
 #include <time.h>
 #include <vector>
-#include <iostream>
-#include <random>
+#include <atomic>
+#include <cstdint>
+
+// My includes.
+#include "Philox.hpp"
 
 namespace sann{
 namespace math{
 
-/// This class offers only static methods for random calculations.
+/// This class offers only static methods for random calculations. The numbers are drawn from Philox streams 
+/// derived from one master seed: each thread has its own stream, and setStream() can bind the current thread to
+/// a given stream (e.g. one per task), so the results are reproducible even under OpenMP.
 
 class Randomizer{
 private:
-    static int initSeed;
+    static std::atomic<uint64_t> masterSeed, nextStream;
+
+    /**
+     * @brief Returns the generator of the current thread. It is rebuilt if the master seed has changed.
+     * 
+     * @return Philox& - The generator.
+     */
+    static Philox& generator(){
+        thread_local Philox gen{masterSeed.load(), THREAD_STREAMS | nextStream++};
+        
+        if(gen.getSeed() != masterSeed.load())
+            gen = Philox{masterSeed.load(), THREAD_STREAMS | nextStream++};
+        return gen;
+    }
+
 public:
+    // The streams given to the threads have the highest bit set, so they never clash with setStream() ones.
+    static const uint64_t THREAD_STREAMS = (uint64_t)1 << 63;
+
     // METHOD
 
     /**
-     * @brief Compute a random number between the given bounds.
-     *        NB: this function is not thread safe, use randomRange with seed parameter instead.
+     * @brief Sets the master seed from which all the streams are derived (the time at start up by default).
+     * 
+     * @param seed - The master seed.
+     */
+    static void setSeed(const uint64_t seed){ masterSeed = seed; }
+
+    /**
+     * @brief Binds the current thread to a stream: it will draw the same numbers every time the same stream is
+     *        set with the same master seed.
+     * 
+     * @param id - The id of the stream.
+     */
+    static void setStream(const uint64_t id){ generator() = Philox{masterSeed.load(), id}; }
+
+    /**
+     * @brief Returns a new generator for the given stream, independent from the ones of the threads.
+     * 
+     * @param id - The id of the stream.
+     * @return Philox - The generator.
+     */
+    static Philox stream(const uint64_t id){ return Philox{masterSeed.load(), id}; }
+
+    /**
+     * @brief Compute a random number between the given bounds (the upper one is excluded).
      * 
      * @tparam T - The type of the element of the vector.
      * @param min - The lower bound.
@@ -41,8 +85,7 @@ public:
      */
     template <typename T> 
     static T randomRange(const T min, const T max){
-        double value = (double)rand() / RAND_MAX;
-        return min + value * (max - min);
+        return min + generator().uniform() * (max - min);
     }
 
     /**
@@ -71,13 +114,8 @@ public:
      */
     template <typename T>
     static std::vector<T> randomRangeVector(T min, T max, size_t size){
-        std::vector<T> randomVector;
-        randomVector.reserve(size);
-
-        for(size_t i = 0; i < size; i++){
-            double value = (double)rand() / RAND_MAX;
-            randomVector.push_back(min + value * (max - min));
-        }
+        std::vector<T> randomVector(size);
+        generator().fillUniform(randomVector.data(), size, min, max);
 
         return randomVector;
     }
@@ -116,15 +154,8 @@ public:
      */
     template <typename T>
     static std::vector<T> randomGaussianVector(const T &mean, const T &stddev, size_t size){
-        std::vector<T> randomVector;
-        std::normal_distribution<double> gaussian(mean, stddev);
-        std::random_device rd; 
-        std::mt19937 gen(rd());
-        // std::default_random_engine gen;
-        randomVector.reserve(size);
-
-        for(size_t i = 0; i < size; i++)
-            randomVector.push_back(gaussian(gen));
+        std::vector<T> randomVector(size);
+        generator().fillNormal(randomVector.data(), size, mean, stddev);
 
         return randomVector;
     }
@@ -15,6 +15,7 @@
 #include <sstream>
 #include <iostream>
 #include <algorithm>
+#include <cstdlib>
 
 using namespace std;
 using namespace boost;
@@ -22,6 +23,40 @@ using namespace boost;
 namespace sann {
 namespace utility {
 
+	/**
+	 * @brief Returns the directory in which the library writes its files. It is taken from the environment
+	 *        variable SANN_FILES_DIR if it is set, otherwise it is the "files" folder of the working directory.
+	 * 
+	 * @return string& - The directory, ending with a slash.
+	 */
+	string& FileManager::filesDir(){
+		static string dir = [](){
+			const char *env = getenv("SANN_FILES_DIR");
+			string path = env != nullptr && env[0] != '\0' ? env : "files";
+			return path.back() == '/' ? path : path + '/';
+		}();
+		return dir;
+	}
+
+	/**
+	 * @brief Sets the directory in which the library writes its files, e.g. the results of the validation and
+	 *        the plots. It should be set before any of them is written.
+	 * 
+	 * @param dir - The directory.
+	 */
+	void FileManager::setFilesDir(const std::string &dir){
+		FileManager::filesDir() = dir.empty() || dir.back() == '/' ? dir : dir + '/';
+	}
+
+	/**
+	 * @brief Returns the directory in which the library writes its files (see setFilesDir).
+	 * 
+	 * @return const string& - The directory, ending with a slash (or empty for the working directory).
+	 */
+	const string& FileManager::getFilesDir(){
+		return FileManager::filesDir();
+	}
+
 	/**
 	 * @brief Creates a new folder.
 	 * 
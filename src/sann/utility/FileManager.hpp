@@ -25,10 +25,16 @@ namespace utility {
 /// This class wraps the interaction with the filesystem offering high level methods to interact with it.
 /// It exploits the boost filesystem to manage the folder.
 class FileManager {
+private:
+	// METHODS
+
+	static std::string& filesDir();
 
 public:
 	// METHODS
 
+	static void setFilesDir(const std::string &dir);
+	static const std::string& getFilesDir();
 	static void createFolder(const std::string &folder);
 	static void removeFolder(const std::string &folder);
 	static void cleanFolder(const std::string &folder);
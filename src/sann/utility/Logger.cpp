@@ -10,45 +10,201 @@
 #include "Logger.hpp"
 
 // Other system includes.
-#include <ctime>
+#include <stdexcept>
 
 using namespace std;
 
 const string typeName[4] = {"", "INFO", "WARNING", "ERROR"};
+const string DEFAULT_FILE = "./info.log";
+const size_t MAX_BATCH = 1024; // The maximum number of messages written at once.
 
 namespace sann{
 namespace utility{
 
-    ofstream Logger::logFile = ofstream{"./info.log", std::ios::out | std::ios::app};
-    mutex Logger::mtx;
-    // Write on the file the start point of new session.
-    int Logger::initSession = []() -> int { 
-        Logger::logFile << "\n*****************************NEW SESSION*****************************" << endl; 
-        return 1; 
-    }();
+    atomic<Logger::message*> Logger::head{nullptr};
+    Logger::message *Logger::tail = nullptr;
+    atomic<Logger::type> Logger::level{Logger::type::NONE};
+    atomic<size_t> Logger::pushed{0}, Logger::written{0};
+    once_flag Logger::started;
+    ofstream Logger::logFile;
+    mutex Logger::lock;
+    condition_variable Logger::arrived, Logger::done;
+    atomic<bool> Logger::waiting{false};
+    Logger::worker Logger::consumer;
 
     /**
-     * @brief Writes on the log file.
-     * 
+     * @brief Stops the consumer thread once all the pending messages have been written.
+     *
+     */
+    Logger::worker::~worker(){
+        if(this->thread.joinable()){
+            {
+                lock_guard<mutex> guard(Logger::lock);
+                this->stop = true;
+            }
+            Logger::arrived.notify_one();
+            this->thread.join();
+        }
+    }
+
+    /**
+     * @brief Initializes the queue with an empty node and starts the consumer.
+     *
+     */
+    void Logger::start(){
+        message *stub = new message{};
+        stub->next = nullptr;
+        Logger::tail = stub;
+        Logger::head = stub;
+
+        Logger::consumer.stop = false;
+        Logger::consumer.thread = thread(Logger::writeLoop);
+    }
+
+    /**
+     * @brief Pushes a message on the queue. Any number of threads can push at the same time. The consumer is
+     *        woken up only if it is waiting: both the link of the message and the check of the flag are
+     *        sequentially consistent, so either the consumer sees the message or the writer sees the flag.
+     *
+     * @param msg - The message.
+     */
+    void Logger::push(message *msg){
+        msg->next.store(nullptr, memory_order_relaxed);
+        Logger::pushed.fetch_add(1, memory_order_relaxed);
+        message *prev = Logger::head.exchange(msg, memory_order_acq_rel);
+        prev->next.store(msg, memory_order_seq_cst);
+
+        if(Logger::waiting.load(memory_order_seq_cst)){
+            { lock_guard<mutex> guard(Logger::lock); }
+            Logger::arrived.notify_one();
+        }
+    }
+
+    /**
+     * @brief Pops the oldest message from the queue. Only the consumer thread can call it. The returned message
+     *        becomes the new empty node of the queue, so it must not be deleted.
+     *
+     * @return Logger::message* - The message, or nullptr if the queue is empty.
+     */
+    Logger::message* Logger::pop(){
+        message *next = Logger::tail->next.load(memory_order_acquire);
+
+        if(next == nullptr) return nullptr;
+
+        delete Logger::tail;
+        Logger::tail = next;
+        return next;
+    }
+
+    /**
+     * @brief The body of the consumer thread: it formats the messages and writes them in batches, flushing
+     *        the file once per batch.
+     *
+     */
+    void Logger::writeLoop(){
+        string batch;
+
+        while(true){
+            size_t count = 0;
+            message *msg;
+
+            while(count < MAX_BATCH && (msg = Logger::pop()) != nullptr){
+                ++count;
+
+                // Take the new log file, or open the default one if no file has been set before the first message.
+                if(msg->reopen || !Logger::logFile.is_open()){
+                    Logger::logFile << batch << std::flush;
+                    batch.clear();
+                    Logger::logFile.close();
+                    if(msg->reopen) Logger::logFile = move(msg->file);
+                    else            Logger::logFile.open(DEFAULT_FILE, ios::out | ios::app);
+                    batch += "\n*****************************NEW SESSION*****************************\n";
+                    if(msg->reopen) continue;
+                }
+                if(msg->showDate){
+                    string currentTime = asctime(localtime(&msg->time));  // Human readable time.
+                    currentTime.pop_back(); // Delete newline.
+                    batch += currentTime + "\t";
+                }
+                if(msg->type != Logger::type::NONE)  batch += typeName[(short)msg->type] + '\t';
+                batch += msg->text + '\n';
+                msg->text.clear();
+            }
+
+            if(count > 0){
+                Logger::logFile << batch << std::flush;
+                batch.clear();
+                {
+                    lock_guard<mutex> guard(Logger::lock);
+                    Logger::written.fetch_add(count, memory_order_release);
+                }
+                Logger::done.notify_all();
+                continue;
+            }
+
+            // Wait for new messages, the flag is set before checking the queue again.
+            unique_lock<mutex> guard(Logger::lock);
+            Logger::waiting.store(true, memory_order_seq_cst);
+            Logger::arrived.wait(guard, []{ 
+                return Logger::tail->next.load(memory_order_seq_cst) != nullptr || Logger::consumer.stop; 
+            });
+            Logger::waiting.store(false, memory_order_relaxed);
+            if(Logger::tail->next.load(memory_order_acquire) == nullptr)
+                break;
+        }
+    }
+
+    /**
+     * @brief Writes on the log file. The message is only queued, it will be written later by another thread.
+     *
      * @param text - What to write.
      * @param type - The type of the information to write.
      * @param showDate - True if the date must be shown, false otherwise.
      */
     void Logger::writeLog(const string &text, Logger::type type, bool showDate){
-        // Write in the log file.
-        Logger::mtx.lock();
-
-        if(showDate){
-            time_t result = time(nullptr);
-            string currentTime = asctime(localtime(&result));  // Human readable time.
-            currentTime.pop_back(); // Delete newline.
-            Logger::logFile << currentTime << "\t";
-        }
-        if(type != Logger::type::NONE)  Logger::logFile <<  typeName[(short)type] << '\t';
-        Logger::logFile << text << endl; 
+        if(!Logger::isActive(type))    return;
+
+        call_once(Logger::started, Logger::start);
+        Logger::push(new message{{nullptr}, text, type, showDate, false, showDate ? time(nullptr) : 0});
+    }
+
+    /**
+     * @brief Changes the file on which the log is written. The messages already written go on the old file.
+     *        The file is opened right away, so a wrong path is reported to the caller.
+     *
+     * @param path - The path of the new log file.
+     */
+    void Logger::setLogFile(const string &path){
+        ofstream file(path, ios::out | ios::app);
+        if(!file.is_open())
+            throw invalid_argument("The log file " + path + " cannot be opened.");
+
+        call_once(Logger::started, Logger::start);
+        message *msg = new message{{nullptr}, path, Logger::type::NONE, false, true, 0};
+        msg->file = move(file);
+        Logger::push(msg);
+    }
+
+    /**
+     * @brief Sets the minimum type a message must have to be written (NONE by default, i.e. everything).
+     *
+     * @param level - The new level.
+     */
+    void Logger::setLevel(const Logger::type level){
+        Logger::level = level;
+    }
+
+    /**
+     * @brief Waits until all the messages written until now are on the file.
+     *
+     */
+    void Logger::flush(){
+        size_t target = Logger::pushed.load(memory_order_relaxed);
 
-        Logger::mtx.unlock();
+        if(!Logger::consumer.thread.joinable()) return;
+        unique_lock<mutex> guard(Logger::lock);
+        Logger::done.wait(guard, [target]{ return Logger::written.load(memory_order_acquire) >= target; });
     }
 
 }
-}
\ No newline at end of file
+}
@@ -12,26 +12,81 @@
 
 #include <string>
 #include <fstream>
+#include <atomic>
+#include <thread>
 #include <mutex>
+#include <condition_variable>
+#include <ctime>
 
 namespace sann{
 namespace utility{
 
-/// This class takes care of create and update a log files. This class is thread-safe.
+/// This class takes care of create and update a log files. This class is thread-safe and never blocks the
+/// writers: the messages are pushed on a lock-free queue and a background thread writes them in batches. The
+/// writers only take a lock to wake the background thread up when it is waiting for new messages.
+/// Messages with a type lower than the active level are dropped before doing anything.
 class Logger{
+public:
 
+    enum class type{NONE, INFO, WARN, ERROR};
+
+private:
+    // STRUCT
+
+    struct message{
+        std::atomic<message*> next;
+        std::string text;
+        Logger::type type;
+        bool showDate, reopen;
+        std::time_t time;
+        std::ofstream file;     // The new log file, opened by setLogFile.
+    };
+
+    /// The consumer of the queue, it is stopped at the end of the program.
+    struct worker{
+        std::thread thread;
+        std::atomic<bool> stop;
+        ~worker();
+    };
+
+    // ATTRIBUTES
+
+    static std::atomic<message*> head;
+    static message *tail;
+    static std::atomic<Logger::type> level;
+    static std::atomic<std::size_t> pushed, written;
+    static std::once_flag started;
     static std::ofstream logFile;
-    static std::mutex mtx;
-    static int initSession;
+    static std::mutex lock;
+    static std::condition_variable arrived, done;   // Signal new messages and written batches.
+    static std::atomic<bool> waiting;               // True while the consumer waits for new messages.
+    static worker consumer;
 
-public: 
+    // METHODS
 
-    enum class type{NONE, INFO, WARN, ERROR};
+    static void start();
+    static void push(message *msg);
+    static message* pop();
+    static void writeLoop();
+
+public:
 
     static void writeLog(const std::string &text, Logger::type type = Logger::type::INFO, bool showDate = true);
+    static void setLogFile(const std::string &path);
+    static void setLevel(const Logger::type level);
+    static void flush();
+
+    /**
+     * @brief Returns true if the messages of the given type are written. It can be used to avoid building
+     *        messages that would be dropped.
+     *
+     * @param type - The type of the message.
+     * @return bool - True if the message would be written.
+     */
+    static inline bool isActive(const Logger::type type){ return type >= Logger::level.load(std::memory_order_relaxed); }
 };
 
 }
 }
 
-#endif
\ No newline at end of file
+#endif
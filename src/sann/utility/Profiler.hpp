@@ -0,0 +1,75 @@
+/*******************************************************
+ *                                                     *
+ *  sann: Neural Network library                       *
+ *                                                     *
+ *  PROFILER CLASS HEADER                              *
+ *                                                     *
+ *  Giulio Auriemma                                    *
+ *                                                     *
+ *******************************************************/
+#ifndef S_UTILITY_PROFILER_S
+#define S_UTILITY_PROFILER_S
+
+// System libraries include.
+#include <array>
+#include <string>
+
+// My includes.
+#include "Stopwatch.hpp"
+
+namespace sann{
+namespace utility{
+
+/// This class splits the time of a training in phases. The timers are compiled only if S_PROFILE_MODE_S is
+/// defined, otherwise the S_PROFILE_SCOPE macro expands to nothing and the training has no overhead at all.
+class Profiler{
+public:
+    // ENUMERATION
+
+    enum phase{FORWARD, LOSS, BACKWARD, UPDATE, VALIDATION, ESTIMATOR};
+    static const std::size_t PHASES = 6;
+
+    // TYPEDEF
+
+    typedef std::array<double, PHASES> timings; // The seconds spent in each phase.
+
+    // CLASSES
+
+    /// A timer that adds the time passed from its creation to its destruction to a phase.
+    class scope{
+    private:
+        Stopwatch sw;
+        double &target;
+    public:
+        scope(timings &t, const phase p) : target(t[p]){ }
+        ~scope(){ this->target += this->sw.end(); }
+    };
+
+    // METHODS
+
+    /**
+     * @brief Returns the name of a phase.
+     *
+     * @param p - The phase.
+     * @return std::string - The name.
+     */
+    static std::string name(const phase p){
+        static const std::string names[PHASES] = {"forward", "loss", "backward", "update", "validation", "estimator"};
+        return names[p];
+    }
+};
+
+}
+}
+
+#define S_PROFILE_CONCAT_(a, b) a##b
+#define S_PROFILE_CONCAT(a, b) S_PROFILE_CONCAT_(a, b)
+
+#ifdef S_PROFILE_MODE_S
+#define S_PROFILE_SCOPE(timings, p) \
+    sann::utility::Profiler::scope S_PROFILE_CONCAT(s_profile_scope_, __LINE__){timings, sann::utility::Profiler::p}
+#else
+#define S_PROFILE_SCOPE(timings, p)
+#endif
+
+#endif